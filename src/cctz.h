@@ -34,8 +34,10 @@
 #define CCTZ_H_
 
 #include <chrono>
+#include <cstddef>
 #include <cstdint>
 #include <string>
+#include <vector>
 
 namespace cctz {
 
@@ -80,11 +82,37 @@ class TimeZone {
 // zone. If the name is invalid, or some other kind of error occurs, returns
 // false and "*tz" is set to the UTC time zone.
 bool LoadTimeZone(const std::string& name, TimeZone* tz);
+// Equivalents to the above that take the name as a NUL-terminated string,
+// or as a character array of the given length (e.g., a slice of some larger
+// buffer). Neither allocates once the named zone has been loaded.
+bool LoadTimeZone(const char* name, TimeZone* tz);
+bool LoadTimeZone(const char* name, std::size_t len, TimeZone* tz);
 // Convenience method returning the UTC time zone.
 TimeZone UTCTimeZone();
 // Convenience method returning the local time zone, or UTC if there is no
 // configured local zone.
 TimeZone LocalTimeZone();
+// Loads the named zones ahead of their first use, reading and decoding them
+// in parallel, so that later loads of them perform no I/O. Zones that fail
+// to load are remembered as failures, just as by LoadTimeZone(). Returns the
+// number of the named zones that are now loaded successfully.
+std::size_t PreloadTimeZones(const std::vector<std::string>& names);
+// Equivalent to the above for every zone in the local zoneinfo tree, that
+// is, for every name of ZoneinfoNames().
+std::size_t PreloadTimeZones();
+// Returns the names of the zones in the local zoneinfo tree (that is, under
+// ${TZDIR} or /usr/share/zoneinfo), sorted. Only the files of zoneinfo
+// data are included, and not the "posix" and "right" variants of the tree,
+// nor the "localtime" and "posixrules" aliases.
+std::vector<std::string> ZoneinfoNames();
+// Loads the data of every zone loaded so far afresh (e.g., after an update
+// of the zoneinfo files), so that all TimeZones, existing or not, convert
+// using the new data. Conversions on other threads are never blocked, and
+// complete using either the old or the new data. The old data is never
+// freed, so this is meant for occasional use. Zones that now fail to load
+// keep their old data, and names that failed to load remain UTC. Returns
+// the number of zones reloaded.
+std::size_t ReloadTimeZones();
 
 // The calendar and wall-clock (a.k.a. "civil time") components of a
 // time_point in a certain TimeZone. A better std::tm. This struct is not
@@ -109,6 +137,90 @@ struct Breakdown {
 // absolute time in the given time zone.
 Breakdown BreakTime(const time_point& tp, const TimeZone& tz);
 
+// Like Breakdown, but the time-zone abbreviation refers to NUL-terminated
+// storage owned by the TimeZone instead of being copied into a std::string.
+// Loaded TimeZones are never destroyed, so the pointer remains valid for
+// the life of the program. Prefer BreakTimeLite() when converting many
+// times and rarely needing the abbreviation, as it never allocates.
+struct BreakdownLite {
+  int64_t year;        // year (e.g., 2013)
+  int month;           // month of year [1:12]
+  int day;             // day of month [1:31]
+  int hour;            // hour of day [0:23]
+  int minute;          // minute of hour [0:59]
+  int second;          // second of minute [0:59]
+  duration subsecond;  // [0s:1s)
+  int weekday;         // 1==Mon, ..., 7=Sun
+  int yearday;         // day of year [1:366]
+  int offset;          // seconds east of UTC
+  bool is_dst;         // is offset non-standard?
+  const char* abbr;    // time-zone abbreviation (e.g., "PST")
+};
+
+// Returns the same civil time components as BreakTime(), but without
+// copying the time-zone abbreviation.
+BreakdownLite BreakTimeLite(const time_point& tp, const TimeZone& tz);
+
+// Equivalents to BreakTime() and BreakTimeLite() for an absolute time given
+// as seconds since the Unix epoch and a subsecond (normally in [0s:1s), but
+// larger or negative subseconds carry into the seconds), or as a time_point
+// of the std::chrono::system_clock with any 64-bit duration (e.g., that of
+// system_clock::now()). These convert using only 64-bit arithmetic. (The
+// cctz::time_point versions also do so, unless the time_point falls outside
+// the +-292 years that 64 bits of nanoseconds can represent.)
+Breakdown BreakTime(int64_t unix_seconds, std::chrono::nanoseconds subsecond,
+                    const TimeZone& tz);
+BreakdownLite BreakTimeLite(int64_t unix_seconds,
+                            std::chrono::nanoseconds subsecond,
+                            const TimeZone& tz);
+template <typename D>
+Breakdown BreakTime(
+    const std::chrono::time_point<std::chrono::system_clock, D>& tp,
+    const TimeZone& tz);
+template <typename D>
+BreakdownLite BreakTimeLite(
+    const std::chrono::time_point<std::chrono::system_clock, D>& tp,
+    const TimeZone& tz);
+
+// Caller-provided output arrays for BreakTimes(), each of which receives
+// one BreakdownLite field per converted time (i.e., a "column"). Columns
+// that are not needed may be left null, and are then not written.
+//
+// Example:
+//   std::vector<int64_t> secs = ...;
+//   std::vector<int64_t> years(secs.size());
+//   std::vector<int> months(secs.size());
+//   cctz::BreakdownColumns cols;
+//   cols.year = years.data();
+//   cols.month = months.data();
+//   cctz::BreakTimes(secs.data(), secs.size(), tz, cols);
+struct BreakdownColumns {
+  int64_t* year = nullptr;
+  int* month = nullptr;
+  int* day = nullptr;
+  int* hour = nullptr;
+  int* minute = nullptr;
+  int* second = nullptr;
+  duration* subsecond = nullptr;
+  int* weekday = nullptr;
+  int* yearday = nullptr;
+  int* offset = nullptr;
+  bool* is_dst = nullptr;
+  const char** abbr = nullptr;
+};
+
+// Converts n absolute times to civil time in the given time zone, exactly
+// as BreakTimeLite() would, storing element i of the result at index i of
+// each non-null column. The times may be given either as seconds since the
+// Unix epoch (in which case all subseconds are zero) or as time_points.
+// Much faster than converting the times one at a time, particularly when
+// neighbouring times fall between the same pair of zone transitions (e.g.,
+// when they are sorted or clustered).
+void BreakTimes(const int64_t* unix_seconds, std::size_t n,
+                const TimeZone& tz, const BreakdownColumns& out);
+void BreakTimes(const time_point* tps, std::size_t n,
+                const TimeZone& tz, const BreakdownColumns& out);
+
 // Returns the cctz::time_point corresponding to the given civil time fields
 // in the given TimeZone after normalizing the fields. If the given civil time
 // refers to a time that is either skipped or repeated (see the TimeInfo doc),
@@ -170,7 +282,7 @@ time_point MakeTime(int64_t year, int mon, int day, int hour, int min, int sec,
 //   // ti.kind == TimeInfo::Kind::UNIQUE && ti.normalized == true
 //   // ti.pre.In(tz).month == 11 && ti.pre.In(tz).day == 1
 struct TimeInfo {
-  enum class Kind {
+  enum class Kind : uint8_t {
     UNIQUE,    // the civil time was singular (pre == trans == post)
     SKIPPED,   // the civil time did not exist
     REPEATED,  // the civil time was ambiguous
@@ -188,6 +300,77 @@ struct TimeInfo {
 TimeInfo MakeTimeInfo(int64_t year, int mon, int day, int hour,
                       int min, int sec, const TimeZone& tz);
 
+// Caller-provided input arrays for MakeTimes(), each of which supplies one
+// civil-time field per time to convert. The year, month, and day columns
+// are required, while any of the hour, minute, and second columns may be
+// left null, in which case those fields are taken to be zero.
+struct CivilColumns {
+  const int64_t* year = nullptr;
+  const int* month = nullptr;
+  const int* day = nullptr;
+  const int* hour = nullptr;
+  const int* minute = nullptr;
+  const int* second = nullptr;
+};
+
+// Converts n civil times in the given time zone to absolute times, exactly
+// as MakeTime() would, storing the result for row i of the columns at index
+// i of the output array. If kinds is non-null, the TimeInfo::Kind of each
+// conversion is also stored there, so that callers can find any skipped or
+// repeated civil times. Much faster than converting the rows one at a time,
+// particularly when neighbouring rows fall between the same pair of zone
+// transitions and their fields are already in range.
+void MakeTimes(const CivilColumns& civil, std::size_t n, const TimeZone& tz,
+               int64_t* unix_seconds, TimeInfo::Kind* kinds);
+void MakeTimes(const CivilColumns& civil, std::size_t n, const TimeZone& tz,
+               time_point* tps, TimeInfo::Kind* kinds);
+
+// Returns the first instant of the civil day (or hour) in the given time
+// zone that contains the absolute time. That is, the time of its midnight
+// (or of the top of its hour), or the first of them if that civil time was
+// repeated, or the transition at which the day (or hour) began if it was
+// skipped. Equivalent to breaking the time down, zeroing the fields below
+// the day (or hour), and converting back, but in the common case costs no
+// more than the single lookup of the offset in effect, making it suitable
+// for rolling up times by local day (or hour). The times may be given
+// either as time_points, or as seconds since the Unix epoch.
+//
+// Example:
+//   // 2015-01-02 00:00:00 -08:00
+//   cctz::time_point day = cctz::StartOfDay(
+//       cctz::MakeTime(2015, 1, 2, 3, 4, 5, lax), lax);
+time_point StartOfDay(const time_point& tp, const TimeZone& tz);
+time_point StartOfHour(const time_point& tp, const TimeZone& tz);
+int64_t StartOfDay(int64_t unix_seconds, const TimeZone& tz);
+int64_t StartOfHour(int64_t unix_seconds, const TimeZone& tz);
+
+// Finds the first transition of the time zone after the given absolute
+// time, that is, the first instant at which its UTC offset, DST flag, or
+// abbreviation changes, and stores it in *trans. Returns false, leaving
+// *trans unchanged, if there is no later transition (e.g., for UTC and
+// other fixed offsets, and for zones backed by libc). PrevTransition()
+// likewise finds the last transition before the given time. The times may
+// be given either as time_points, or as seconds since the Unix epoch.
+//
+// Between consecutive transitions the offset is constant, so a range of
+// times can be converted a segment at a time, with one lookup for each.
+//
+// Example:
+//   // The DST changes of 2015 in Los Angeles.
+//   cctz::time_point tp = cctz::MakeTime(2015, 1, 1, 0, 0, 0, lax);
+//   const cctz::time_point end = cctz::MakeTime(2016, 1, 1, 0, 0, 0, lax);
+//   while (cctz::NextTransition(tp, lax, &tp) && tp < end) {
+//     // tp is 2015-03-08 03:00:00 -07:00, then 2015-11-01 01:00:00 -08:00
+//   }
+bool NextTransition(const time_point& tp, const TimeZone& tz,
+                    time_point* trans);
+bool PrevTransition(const time_point& tp, const TimeZone& tz,
+                    time_point* trans);
+bool NextTransition(int64_t unix_seconds, const TimeZone& tz,
+                    int64_t* trans);
+bool PrevTransition(int64_t unix_seconds, const TimeZone& tz,
+                    int64_t* trans);
+
 // Formats the given cctz::time_point in the given cctz::TimeZone according to
 // the provided format string. Uses strftime()-like formatting options, with
 // the following extensions:
@@ -214,6 +397,170 @@ TimeInfo MakeTimeInfo(int64_t year, int mon, int day, int hour,
 std::string Format(const std::string& format, const time_point& tp,
                    const TimeZone& tz);
 
+// cctz::CompiledFormat is a Format() pattern that has been scanned once,
+// up front, into a sequence of conversions, so that formatting many times
+// with the same pattern does not pay to rediscover its specifiers. The
+// output is identical to that of Format() with the original string.
+//
+// Example:
+//   static const cctz::CompiledFormat kLogFormat("%Y-%m-%d %H:%M:%E6S %Ez");
+//   std::string s = cctz::Format(kLogFormat, tp, lax);
+class CompiledFormat {
+ public:
+  explicit CompiledFormat(const std::string& format);
+  CompiledFormat(const CompiledFormat&) = default;
+  CompiledFormat& operator=(const CompiledFormat&) = default;
+
+ private:
+  friend std::string Format(const CompiledFormat& format,
+                            const time_point& tp, const TimeZone& tz);
+  friend void Format(const CompiledFormat& format, const time_point& tp,
+                     const TimeZone& tz, std::string* dst);
+  friend std::size_t Format(const CompiledFormat& format,
+                            const time_point& tp, const TimeZone& tz,
+                            char* buf, std::size_t size);
+
+  enum class OpKind : uint8_t {
+    kLiteral,        // text copied verbatim
+    kStrftime,       // text handed to strftime(3)
+    kYear,           // %Y
+    kYear4,          // %E4Y
+    kYear2,          // %y
+    kCentury,        // %C
+    kMonth,          // %m
+    kDay,            // %d
+    kDaySpace,       // %e
+    kYearDay,        // %j
+    kWeekdayMon,     // %u
+    kWeekdaySun,     // %w
+    kWeekSun,        // %U
+    kWeekMon,        // %W
+    kHour,           // %H
+    kHour12,         // %I
+    kMinute,         // %M
+    kSecond,         // %S
+    kSecondN,        // %E#S, with arg digits
+    kSecondStar,     // %E*S
+    kDate,           // %F
+    kDateSlash,      // %D, and %x in the C locale
+    kTime,           // %T, and %X in the C locale
+    kHourMinute,     // %R
+    kTime12,         // %r in the C locale
+    kWeekdayShort,   // %a in the C locale
+    kWeekdayLong,    // %A in the C locale
+    kMonthShort,     // %b and %h in the C locale
+    kMonthLong,      // %B in the C locale
+    kAmPm,           // %p in the C locale
+    kOffset,         // %z
+    kOffsetColon,    // %Ez
+    kAbbr,           // %Z
+    kUnixSeconds,    // %s
+  };
+
+  // Ops other than kLiteral retain their original specifier as text, so
+  // that they can fall back to strftime(3) when the native conversion does
+  // not apply (i.e., outside the C locale, or for years that the std::tm
+  // would render differently).
+  struct Op {
+    OpKind kind;
+    int arg;          // the precision of kSecondN
+    bool c_locale;    // only converted natively in the C/POSIX locale
+    std::size_t pos;  // the text of the op, which is NUL-terminated ...
+    std::size_t len;  // ... in text_ for all but kLiteral
+  };
+
+  void AddText(OpKind kind, const char* text, std::size_t len);
+  void AddOp(OpKind kind, int arg, bool c_locale,
+             const char* spec, std::size_t len);
+
+  // Formats tp in tz, writing the result to *sink.
+  class Sink;
+  void Run(const time_point& tp, const TimeZone& tz, Sink* sink) const;
+
+  friend class CachedFormat;  // which assembles formats from our ops
+
+  std::vector<Op> ops_;
+  std::string text_;
+};
+
+// Formats the given cctz::time_point in the given cctz::TimeZone according
+// to the given compiled format.
+std::string Format(const CompiledFormat& format, const time_point& tp,
+                   const TimeZone& tz);
+
+// Equivalents to the above that, rather than returning a new string, append
+// the result to *dst, or write it into the size characters at buf (without
+// a terminating NUL). The latter returns the length of the full result, so
+// a return value greater than size means that the output was truncated, and
+// that a buffer of that size is needed. Neither allocates unless *dst needs
+// to grow, or the format contains conversions that are delegated to the
+// (locale-specific) strftime(3).
+//
+// Example:
+//   char buf[64];
+//   std::size_t len = cctz::Format(kLogFormat, tp, lax, buf, sizeof(buf));
+//   if (len <= sizeof(buf)) { /* [buf, buf + len) is the result */ }
+void Format(const CompiledFormat& format, const time_point& tp,
+            const TimeZone& tz, std::string* dst);
+std::size_t Format(const CompiledFormat& format, const time_point& tp,
+                   const TimeZone& tz, char* buf, std::size_t size);
+
+// cctz::CachedFormat is a CompiledFormat that also remembers, in each
+// thread, the result of the last whole second it formatted in a zone, so
+// that formatting another time within that second only copies the result
+// and fills in the digits of any subseconds (%E#S and %E*S). This suits a
+// high-rate logger, whose timestamps mostly fall in the same second as the
+// one before, as it then needs neither a BreakTime() nor a pass over the
+// pattern. The output is identical to that of Format() with the original
+// string, except that a change of locale may not be seen by a second that
+// is already cached. Each thread caches a few seconds, across all formats
+// and zones.
+//
+// Example:
+//   static const cctz::CachedFormat kLogFormat("%Y-%m-%d %H:%M:%E6S %Ez");
+//   char buf[64];
+//   std::size_t len = cctz::Format(kLogFormat, tp, lax, buf, sizeof(buf));
+class CachedFormat {
+ public:
+  explicit CachedFormat(const std::string& format);
+  CachedFormat(const CachedFormat&) = default;
+  CachedFormat& operator=(const CachedFormat&) = default;
+
+ private:
+  friend std::string Format(const CachedFormat& format,
+                            const time_point& tp, const TimeZone& tz);
+  friend void Format(const CachedFormat& format, const time_point& tp,
+                     const TimeZone& tz, std::string* dst);
+  friend std::size_t Format(const CachedFormat& format,
+                            const time_point& tp, const TimeZone& tz,
+                            char* buf, std::size_t size);
+
+  // Formats tp in tz, writing the result to *dst or buf, as Format() does.
+  void Run(const time_point& tp, const TimeZone& tz, std::string* dst) const;
+  std::size_t Run(const time_point& tp, const TimeZone& tz,
+                  char* buf, std::size_t size) const;
+  void Run(const time_point& tp, const TimeZone& tz,
+           CompiledFormat::Sink* sink) const;
+
+  // The format, then split around its subsecond fields (which are left as
+  // %S): segments_[i] precedes a fraction of fractions_[i] digits (or -1
+  // for %E*S), and the final segment follows the last fraction.
+  CompiledFormat format_;
+  std::vector<CompiledFormat> segments_;
+  std::vector<int> fractions_;
+  bool truncates_;  // has %s, which rounds toward zero rather than down
+  uint64_t id_;     // identifies the format in the per-thread caches
+};
+
+// Formats the given cctz::time_point in the given cctz::TimeZone according
+// to the given cached format, with the same three forms as above.
+std::string Format(const CachedFormat& format, const time_point& tp,
+                   const TimeZone& tz);
+void Format(const CachedFormat& format, const time_point& tp,
+            const TimeZone& tz, std::string* dst);
+std::size_t Format(const CachedFormat& format, const time_point& tp,
+                   const TimeZone& tz, char* buf, std::size_t size);
+
 // Parses an input string according to the provided format string and returns
 // the corresponding cctz::time_point. Uses strftime()-like formatting
 // options, with the same extensions as cctz::Format().
@@ -249,9 +596,120 @@ std::string Format(const std::string& format, const time_point& tp,
 //   "00.x" -> 00.x  // exact
 //
 // Errors are indicated by returning false.
+//
+// Well-formed input in the RFC3339 layouts "%Y-%m-%dT%H:%M:%E*S%Ez" and
+// "%Y-%m-%dT%H:%M:%S%Ez" is recognized and parsed especially quickly.
 bool Parse(const std::string& format, const std::string& input,
            const TimeZone& tz, time_point* tpp);
 
+// cctz::CompiledParser is a Parse() format that has been scanned once, up
+// front, into a sequence of matching steps, so that parsing many inputs with
+// the same format does not pay to rediscover its specifiers. The results are
+// identical to those of Parse() with the original format string.
+//
+// Example:
+//   static const cctz::CompiledParser kLogFormat("%Y-%m-%d %H:%M:%E*S %Ez");
+//   cctz::time_point tp;
+//   if (!cctz::Parse(kLogFormat, buf, len, lax, &tp)) { ... }
+class CompiledParser {
+ public:
+  explicit CompiledParser(const std::string& format);
+  CompiledParser(const CompiledParser&) = default;
+  CompiledParser& operator=(const CompiledParser&) = default;
+
+ private:
+  friend bool Parse(const CompiledParser& format, const char* input,
+                    std::size_t len, const TimeZone& tz, time_point* tpp);
+  friend bool Parse(const CompiledParser& format, const char* input,
+                    std::size_t len, const TimeZone& tz, time_point* tpp,
+                    std::size_t* consumed);
+
+  enum class OpKind : uint8_t {
+    kSpace,           // any amount of whitespace
+    kLiteral,         // text matched exactly
+    kFail,            // a trailing '%'
+    kYear,            // %Y
+    kYear4,           // %E4Y
+    kMonth,           // %m
+    kDay,             // %d
+    kHour,            // %H
+    kMinute,          // %M
+    kSecond,          // %S and %E0S
+    kSecondFraction,  // %E*S and %E#S
+    kOffset,          // %z
+    kOffsetColon,     // %Ez
+    kZone,            // %Z
+    kUnixSeconds,     // %s
+    kStrptime,        // text handed to strptime(3)
+  };
+
+  struct Op {
+    OpKind kind;
+    int8_t twelve_hour;  // whether %H (0) or %I (1) is used, or -1
+    bool am_pm;          // kStrptime of %p
+    std::size_t pos;     // the text of the op, as a NUL-terminated ...
+    std::size_t len;     // ... substring of text_
+  };
+
+  // Which RFC3339 layout, if any, the format is.
+  enum class RFC3339 : uint8_t { kNone, kFull, kSec };
+
+  void AddOp(OpKind kind, int twelve_hour, const char* text, std::size_t len);
+
+  // Parses the len characters at input, which need not be NUL terminated.
+  // If consumed is null the whole of the input must match, otherwise only
+  // a prefix of it, the length of which is stored in *consumed.
+  bool Run(const char* input, std::size_t len, const TimeZone& tz,
+           time_point* tpp, std::size_t* consumed) const;
+
+  std::vector<Op> ops_;
+  std::string text_;
+  RFC3339 rfc3339_ = RFC3339::kNone;
+};
+
+// Parses the len characters at input, which need not be NUL terminated,
+// according to the given compiled format, like Parse() above. The first
+// form requires that the whole of the input match, allowing only trailing
+// whitespace. The second form instead matches a prefix of the input, and
+// stores its length in *consumed, so that a timestamp may be parsed where
+// it sits inside some larger record, without copying it out.
+//
+// Example:
+//   static const cctz::CompiledParser kFormat("%Y-%m-%dT%H:%M:%E*S%Ez");
+//   std::size_t n;
+//   if (cctz::Parse(kFormat, p, end - p, utc, &tp, &n)) p += n;
+bool Parse(const CompiledParser& format, const char* input, std::size_t len,
+           const TimeZone& tz, time_point* tpp);
+bool Parse(const CompiledParser& format, const char* input, std::size_t len,
+           const TimeZone& tz, time_point* tpp, std::size_t* consumed);
+
+// Implementation details follow. The system_clock epoch is taken to be the
+// Unix epoch, as std::chrono::system_clock::from_time_t(0) is everywhere.
+
+template <typename D>
+Breakdown BreakTime(
+    const std::chrono::time_point<std::chrono::system_clock, D>& tp,
+    const TimeZone& tz) {
+  const std::chrono::seconds secs =
+      std::chrono::duration_cast<std::chrono::seconds>(tp.time_since_epoch());
+  return BreakTime(secs.count(),
+                   std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       tp.time_since_epoch() - secs),
+                   tz);
+}
+
+template <typename D>
+BreakdownLite BreakTimeLite(
+    const std::chrono::time_point<std::chrono::system_clock, D>& tp,
+    const TimeZone& tz) {
+  const std::chrono::seconds secs =
+      std::chrono::duration_cast<std::chrono::seconds>(tp.time_since_epoch());
+  return BreakTimeLite(secs.count(),
+                       std::chrono::duration_cast<std::chrono::nanoseconds>(
+                           tp.time_since_epoch() - secs),
+                       tz);
+}
+
 }  // namespace cctz
 
 #endif  // CCTZ_H_
@@ -0,0 +1,237 @@
+// Copyright 2015 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+//     Unless required by applicable law or agreed to in writing, software
+//     distributed under the License is distributed on an "AS IS" BASIS,
+//     WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+//     implied.
+//     See the License for the specific language governing permissions and
+//     limitations under the License.
+
+#include "src/cctz_bundle.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <initializer_list>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+#include "src/cctz_info.h"
+
+namespace cctz {
+
+namespace {
+
+const char kBundleMagic[8] = {'C', 'C', 'T', 'Z', 'B', 'N', 'D', 'L'};
+const uint32_t kBundleVersion = 1;
+const uint32_t kByteOrder = 0x01020304;
+
+struct BundleHeader {
+  char magic[8];        // kBundleMagic
+  uint32_t version;     // kBundleVersion
+  uint32_t byte_order;  // kByteOrder, as written by the builder
+  uint32_t zone_count;
+  uint32_t reserved;
+  uint64_t entries;     // BundleEntry[zone_count]
+};
+
+struct BundleEntry {
+  uint64_t name;  // char[name_len]
+  uint64_t record;
+  uint32_t name_len;
+  uint32_t reserved;
+};
+
+// A validated bundle, mapped for the life of the process.
+struct Bundle {
+  const char* base;
+  std::size_t size;
+  const BundleEntry* entries;
+  uint32_t count;
+};
+
+// Orders zone names in the bundle directory.
+int CompareNames(const char* a, std::size_t alen,
+                 const char* b, std::size_t blen) {
+  const int c = std::memcmp(a, b, std::min(alen, blen));
+  if (c != 0) return c;
+  return (alen < blen) ? -1 : (alen > blen) ? 1 : 0;
+}
+
+// Checks the header and directory of the size bytes at base, and returns
+// the bundle they describe, or nullptr. The records themselves are only
+// checked as each zone is loaded.
+Bundle* ValidateBundle(const char* base, std::size_t size) {
+  if (reinterpret_cast<uintptr_t>(base) % 8 != 0) return nullptr;
+  if (size < sizeof(BundleHeader)) return nullptr;
+  const BundleHeader* hdr = reinterpret_cast<const BundleHeader*>(base);
+  if (std::memcmp(hdr->magic, kBundleMagic, sizeof kBundleMagic) != 0 ||
+      hdr->version != kBundleVersion || hdr->byte_order != kByteOrder)
+    return nullptr;
+  if (hdr->entries > size || hdr->entries % 8 != 0 ||
+      (size - hdr->entries) / sizeof(BundleEntry) < hdr->zone_count)
+    return nullptr;
+  const BundleEntry* entries =
+      reinterpret_cast<const BundleEntry*>(base + hdr->entries);
+  for (uint32_t i = 0; i != hdr->zone_count; ++i) {
+    const BundleEntry& e = entries[i];
+    if (e.name > size || size - e.name < e.name_len || e.record > size)
+      return nullptr;
+    if (i != 0) {
+      const BundleEntry& p = entries[i - 1];
+      if (CompareNames(base + p.name, p.name_len,
+                       base + e.name, e.name_len) >= 0)
+        return nullptr;  // out of order
+    }
+  }
+  return new Bundle{base, size, entries, hdr->zone_count};
+}
+
+// Maps and validates the bundle file at path.
+Bundle* MapBundle(const std::string& path) {
+  const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    char ebuf[64] = "Failed to open";
+    strerror_r(errno, ebuf, sizeof ebuf);
+    std::clog << path << ": " << ebuf << "\n";
+    return nullptr;
+  }
+  Bundle* bundle = nullptr;
+  struct stat st;
+  if (fstat(fd, &st) == 0 && st.st_size > 0) {
+    const std::size_t size = static_cast<std::size_t>(st.st_size);
+    void* const addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr != MAP_FAILED) {
+      bundle = ValidateBundle(static_cast<const char*>(addr), size);
+      if (bundle == nullptr) munmap(addr, size);
+    }
+  }
+  close(fd);
+  if (bundle == nullptr) std::clog << path << ": Invalid zone bundle\n";
+  return bundle;
+}
+
+// The bundle in use, and the one compiled into the binary. Zones adopt
+// their tables in place, so a bundle is never unmapped, even once replaced.
+std::atomic<const Bundle*> current_bundle(nullptr);
+std::atomic<const Bundle*> builtin_bundle(nullptr);
+std::once_flag bundle_from_env;
+
+void UseBundleFromEnvironment() {
+  std::call_once(bundle_from_env, [] {
+    if (const char* path = std::getenv("CCTZ_BUNDLE")) {
+      if (const Bundle* bundle = MapBundle(path))
+        current_bundle.store(bundle, std::memory_order_release);
+    }
+  });
+}
+
+// Returns the directory entry for name, or nullptr.
+const BundleEntry* FindZone(const Bundle& bundle, const std::string& name) {
+  const BundleEntry* first = bundle.entries;
+  const BundleEntry* last = first + bundle.count;
+  const BundleEntry* it = std::lower_bound(
+      first, last, name, [&bundle](const BundleEntry& e,
+                                   const std::string& n) {
+        return CompareNames(bundle.base + e.name, e.name_len,
+                            n.data(), n.size()) < 0;
+      });
+  if (it == last) return nullptr;
+  if (CompareNames(bundle.base + it->name, it->name_len,
+                   name.data(), name.size()) != 0)
+    return nullptr;
+  return it;
+}
+
+}  // namespace
+
+bool TimeZoneInfo::LoadFromBundle(const std::string& name) {
+  UseBundleFromEnvironment();
+  for (const std::atomic<const Bundle*>* source :
+       {&current_bundle, &builtin_bundle}) {
+    const Bundle* bundle = source->load(std::memory_order_acquire);
+    if (bundle == nullptr) continue;
+    const BundleEntry* e = FindZone(*bundle, name);
+    if (e != nullptr && LoadBundleRecord(bundle->base, bundle->size, e->record))
+      return true;
+  }
+  return false;
+}
+
+bool UseZoneBundle(const std::string& path) {
+  UseBundleFromEnvironment();  // so that it cannot later override path
+  const Bundle* bundle = MapBundle(path);
+  if (bundle == nullptr) return false;
+  current_bundle.store(bundle, std::memory_order_release);
+  return true;
+}
+
+bool RegisterBuiltinZoneBundle(const char* data, std::size_t size) {
+  const Bundle* bundle = ValidateBundle(data, size);
+  if (bundle == nullptr) return false;
+  builtin_bundle.store(bundle, std::memory_order_release);
+  return true;
+}
+
+void BuildZoneBundle(const std::vector<std::string>& names,
+                     std::string* bundle, std::vector<std::string>* skipped) {
+  std::vector<std::string> sorted(names);
+  std::sort(sorted.begin(), sorted.end(),
+            [](const std::string& a, const std::string& b) {
+              return CompareNames(a.data(), a.size(), b.data(), b.size()) < 0;
+            });
+  sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+
+  // Decode every zone first, so that the directory can be sized.
+  std::vector<std::pair<std::string, std::unique_ptr<TimeZoneInfo>>> zones;
+  for (const std::string& name : sorted) {
+    std::unique_ptr<TimeZoneInfo> tz(new TimeZoneInfo);
+    if (tz->LoadFile(name)) {
+      zones.emplace_back(name, std::move(tz));
+    } else if (skipped != nullptr) {
+      skipped->push_back(name);
+    }
+  }
+
+  BundleHeader hdr;
+  std::memset(&hdr, 0, sizeof hdr);
+  std::memcpy(hdr.magic, kBundleMagic, sizeof kBundleMagic);
+  hdr.version = kBundleVersion;
+  hdr.byte_order = kByteOrder;
+  hdr.zone_count = static_cast<uint32_t>(zones.size());
+  hdr.entries = sizeof hdr;
+  std::vector<BundleEntry> entries(zones.size());
+  std::memset(entries.data(), 0, sizeof(BundleEntry) * entries.size());
+
+  bundle->assign(sizeof hdr + sizeof(BundleEntry) * entries.size(), '\0');
+  for (std::size_t i = 0; i != zones.size(); ++i) {
+    entries[i].name = bundle->size();
+    entries[i].name_len = static_cast<uint32_t>(zones[i].first.size());
+    bundle->append(zones[i].first);
+  }
+  for (std::size_t i = 0; i != zones.size(); ++i) {
+    entries[i].record = zones[i].second->AppendBundleRecord(bundle);
+  }
+  std::memcpy(&(*bundle)[0], &hdr, sizeof hdr);
+  if (!entries.empty()) {
+    std::memcpy(&(*bundle)[hdr.entries], entries.data(),
+                sizeof(BundleEntry) * entries.size());
+  }
+}
+
+}  // namespace cctz
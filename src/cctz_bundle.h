@@ -0,0 +1,69 @@
+// Copyright 2015 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+//     Unless required by applicable law or agreed to in writing, software
+//     distributed under the License is distributed on an "AS IS" BASIS,
+//     WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+//     implied.
+//     See the License for the specific language governing permissions and
+//     limitations under the License.
+
+// A zone bundle is a single file holding the already-decoded tables of
+// many time zones, so that a process can load zones by mapping one file,
+// rather than by opening and decoding one zoneinfo file per zone. Zones
+// in the bundle are taken from it in preference to the zoneinfo files,
+// and the tables of each are used in place within the mapping.
+//
+// Bundles are built by BuildZoneBundle() below (or tools/zone_bundle_tool),
+// and hold the tables exactly as they are laid out in memory, so they are
+// only usable on machines with the same byte order and data layout as the
+// one that built them. A bundle that does not match is ignored. The format
+// (version 1) is as follows, where every offset is from the start of the
+// bundle and every table is 8-byte aligned.
+//
+//   header   "CCTZBNDL", uint32 version, uint32 byte_order (0x01020304),
+//            uint32 zone_count, uint32 reserved, uint64 entries offset
+//   entries  zone_count x { uint64 name offset, uint64 record offset,
+//                           uint32 name length, uint32 reserved },
+//            ordered by name (as bytes)
+//   names    the zone names, without terminators
+//   records  per zone, a fixed-size record of its counts and future rules
+//            followed by its transition, type and abbreviation tables
+
+#ifndef CCTZ_BUNDLE_H_
+#define CCTZ_BUNDLE_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace cctz {
+
+// Builds a bundle of the named zones from the local zoneinfo files (under
+// ${TZDIR} or /usr/share/zoneinfo) into *bundle. Zones that fail to load
+// are left out, and their names are appended to *skipped if it is not null.
+void BuildZoneBundle(const std::vector<std::string>& names,
+                     std::string* bundle, std::vector<std::string>* skipped);
+
+// Maps the bundle file at path, so that zones loaded after this returns
+// are taken from it where possible. Returns false, and leaves any bundle
+// already in use, if the file cannot be mapped or is not a usable bundle.
+// Zones already loaded are unaffected, and mappings are never released.
+// The bundle named by ${CCTZ_BUNDLE}, if any, is used until this is called.
+bool UseZoneBundle(const std::string& path);
+
+// Makes the size bytes of the bundle at data, which must remain valid for
+// the life of the process (e.g., a bundle compiled into the binary by the
+// cctz_embedded_zones() rule), a source of zones that is consulted after
+// any bundle in use and before the zoneinfo files. Returns false, and
+// leaves any earlier built-in bundle in place, if it is not usable.
+bool RegisterBuiltinZoneBundle(const char* data, std::size_t size);
+
+}  // namespace cctz
+
+#endif  // CCTZ_BUNDLE_H_
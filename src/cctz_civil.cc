@@ -0,0 +1,69 @@
+// Copyright 2015 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+//     Unless required by applicable law or agreed to in writing, software
+//     distributed under the License is distributed on an "AS IS" BASIS,
+//     WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+//     implied.
+//     See the License for the specific language governing permissions and
+//     limitations under the License.
+
+#include "src/cctz_civil.h"
+
+#include <cstdint>
+
+#include "src/cctz_days.h"
+
+namespace cctz {
+
+namespace {
+
+// Returns the floor of n / d, for d > 0.
+int64_t FloorDiv(int64_t n, int64_t d) {
+  return (n >= 0 ? n : n - (d - 1)) / d;
+}
+
+}  // namespace
+
+CivilDay::CivilDay(int64_t year, int month, int day) {
+  // Carry the months into the year, and then count the days on from the
+  // first of the month, so that any day of the month is normalized.
+  const int64_t months = static_cast<int64_t>(month) - 1;
+  const int64_t year_carry = FloorDiv(months, 12);
+  const int mon = static_cast<int>(months - year_carry * 12) + 1;
+  days_ = DayOrdinal(year + year_carry, mon, 1) + (day - 1);
+}
+
+int64_t CivilDay::year() const { return CivilFromDays(days_).year; }
+int CivilDay::month() const { return CivilFromDays(days_).month; }
+int CivilDay::day() const { return CivilFromDays(days_).day; }
+int CivilDay::weekday() const { return CivilFromDays(days_).weekday; }
+int CivilDay::yearday() const { return CivilFromDays(days_).yearday; }
+
+CivilHour::CivilHour(int64_t year, int month, int day, int hour)
+    : hours_((CivilDay(year, month, day) - CivilDay()) * 24 + hour) {}
+
+CivilDay CivilHour::civil_day() const {
+  return CivilDay() + FloorDiv(hours_, 24);
+}
+
+int CivilHour::hour() const {
+  return static_cast<int>(hours_ - FloorDiv(hours_, 24) * 24);
+}
+
+CivilDay ToCivilDay(const time_point& tp, const TimeZone& tz) {
+  const BreakdownLite bd = BreakTimeLite(tp, tz);
+  return CivilDay(bd.year, bd.month, bd.day);
+}
+
+CivilHour ToCivilHour(const time_point& tp, const TimeZone& tz) {
+  const BreakdownLite bd = BreakTimeLite(tp, tz);
+  return CivilHour(bd.year, bd.month, bd.day, bd.hour);
+}
+
+}  // namespace cctz
@@ -0,0 +1,138 @@
+// Copyright 2015 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+//     Unless required by applicable law or agreed to in writing, software
+//     distributed under the License is distributed on an "AS IS" BASIS,
+//     WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+//     implied.
+//     See the License for the specific language governing permissions and
+//     limitations under the License.
+
+// cctz::CivilDay and cctz::CivilHour are value types representing a day,
+// or an hour of a day, in the proleptic Gregorian calendar, but in no
+// particular time zone (i.e., a civil time). Unlike a Breakdown they are
+// always normalized, and they are held as a count of days (or hours), so
+// that stepping through them and taking differences between them is just
+// integer arithmetic. This makes them cheap keys for rolling up absolute
+// times by local day (or hour).
+//
+// Example:
+//   // Counts the events of each local day.
+//   std::map<cctz::CivilDay, int> counts;
+//   for (const cctz::time_point& tp : events) {
+//     ++counts[cctz::ToCivilDay(tp, lax)];
+//   }
+//   const int64_t days = counts.rbegin()->first - counts.begin()->first;
+
+#ifndef CCTZ_CIVIL_H_
+#define CCTZ_CIVIL_H_
+
+#include <cstdint>
+
+#include "src/cctz.h"
+
+namespace cctz {
+
+// A civil day. The default is 1970-01-01.
+class CivilDay {
+ public:
+  CivilDay() : days_(0) {}
+  // Normalizes the fields as MakeTime() does (e.g., 2015-13-32 is the same
+  // day as 2016-02-01). The year must be small enough that the number of
+  // days since 1970 fits in 64 bits.
+  CivilDay(int64_t year, int month, int day);
+
+  // The fields of the day.
+  int64_t year() const;
+  int month() const;    // [1:12]
+  int day() const;      // [1:31]
+  int weekday() const;  // 1==Mon, ..., 7=Sun
+  int yearday() const;  // [1:366]
+
+  // Arithmetic in days.
+  CivilDay& operator+=(int64_t n) { days_ += n; return *this; }
+  CivilDay& operator-=(int64_t n) { days_ -= n; return *this; }
+  CivilDay& operator++() { return *this += 1; }
+  CivilDay& operator--() { return *this -= 1; }
+  CivilDay operator++(int) { const CivilDay d = *this; ++*this; return d; }
+  CivilDay operator--(int) { const CivilDay d = *this; --*this; return d; }
+  friend CivilDay operator+(CivilDay d, int64_t n) { return d += n; }
+  friend CivilDay operator+(int64_t n, CivilDay d) { return d += n; }
+  friend CivilDay operator-(CivilDay d, int64_t n) { return d -= n; }
+  friend int64_t operator-(CivilDay a, CivilDay b) {
+    return a.days_ - b.days_;
+  }
+
+  friend bool operator==(CivilDay a, CivilDay b) {
+    return a.days_ == b.days_;
+  }
+  friend bool operator!=(CivilDay a, CivilDay b) { return !(a == b); }
+  friend bool operator<(CivilDay a, CivilDay b) { return a.days_ < b.days_; }
+  friend bool operator>(CivilDay a, CivilDay b) { return b < a; }
+  friend bool operator<=(CivilDay a, CivilDay b) { return !(b < a); }
+  friend bool operator>=(CivilDay a, CivilDay b) { return !(a < b); }
+
+ private:
+  int64_t days_;  // since 1970-01-01
+};
+
+// A civil hour. The default is 1970-01-01 00:00.
+class CivilHour {
+ public:
+  CivilHour() : hours_(0) {}
+  // Normalizes the fields as MakeTime() does (e.g., 2015-12-31 24:00 is
+  // 2016-01-01 00:00).
+  CivilHour(int64_t year, int month, int day, int hour);
+  // The first hour of the day.
+  explicit CivilHour(CivilDay cd) : hours_((cd - CivilDay()) * 24) {}
+
+  // The day of the hour, and its fields.
+  CivilDay civil_day() const;
+  int64_t year() const { return civil_day().year(); }
+  int month() const { return civil_day().month(); }
+  int day() const { return civil_day().day(); }
+  int hour() const;  // [0:23]
+
+  // Arithmetic in hours.
+  CivilHour& operator+=(int64_t n) { hours_ += n; return *this; }
+  CivilHour& operator-=(int64_t n) { hours_ -= n; return *this; }
+  CivilHour& operator++() { return *this += 1; }
+  CivilHour& operator--() { return *this -= 1; }
+  CivilHour operator++(int) { const CivilHour h = *this; ++*this; return h; }
+  CivilHour operator--(int) { const CivilHour h = *this; --*this; return h; }
+  friend CivilHour operator+(CivilHour h, int64_t n) { return h += n; }
+  friend CivilHour operator+(int64_t n, CivilHour h) { return h += n; }
+  friend CivilHour operator-(CivilHour h, int64_t n) { return h -= n; }
+  friend int64_t operator-(CivilHour a, CivilHour b) {
+    return a.hours_ - b.hours_;
+  }
+
+  friend bool operator==(CivilHour a, CivilHour b) {
+    return a.hours_ == b.hours_;
+  }
+  friend bool operator!=(CivilHour a, CivilHour b) { return !(a == b); }
+  friend bool operator<(CivilHour a, CivilHour b) {
+    return a.hours_ < b.hours_;
+  }
+  friend bool operator>(CivilHour a, CivilHour b) { return b < a; }
+  friend bool operator<=(CivilHour a, CivilHour b) { return !(b < a); }
+  friend bool operator>=(CivilHour a, CivilHour b) { return !(a < b); }
+
+ private:
+  int64_t hours_;  // since 1970-01-01 00:00
+};
+
+// Returns the civil day (or hour) of the absolute time in the given time
+// zone. See also StartOfDay() and StartOfHour() in cctz.h, for the
+// absolute times at which those begin.
+CivilDay ToCivilDay(const time_point& tp, const TimeZone& tz);
+CivilHour ToCivilHour(const time_point& tp, const TimeZone& tz);
+
+}  // namespace cctz
+
+#endif  // CCTZ_CIVIL_H_
@@ -15,7 +15,12 @@
 
 #include "src/cctz.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
 #include <cstdlib>
+#include <cstring>
+#include <limits>
 
 #include "src/cctz_impl.h"
 
@@ -42,11 +47,129 @@ TimeZone LocalTimeZone() {
 }
 
 bool LoadTimeZone(const std::string& name, TimeZone* tz) {
-  return TimeZone::Impl::LoadTimeZone(name, tz);
+  return TimeZone::Impl::LoadTimeZone(name.data(), name.size(), tz);
 }
 
+bool LoadTimeZone(const char* name, TimeZone* tz) {
+  return TimeZone::Impl::LoadTimeZone(name, std::strlen(name), tz);
+}
+
+bool LoadTimeZone(const char* name, std::size_t len, TimeZone* tz) {
+  return TimeZone::Impl::LoadTimeZone(name, len, tz);
+}
+
+std::size_t PreloadTimeZones(const std::vector<std::string>& names) {
+  return TimeZone::Impl::PreloadTimeZones(names);
+}
+
+std::size_t PreloadTimeZones() {
+  return TimeZone::Impl::PreloadTimeZones(ZoneinfoNames());
+}
+
+std::vector<std::string> ZoneinfoNames() {
+  return TimeZoneInfo::ZoneNames();
+}
+
+std::size_t ReloadTimeZones() {
+  return TimeZone::Impl::ReloadTimeZones();
+}
+
+namespace {
+
+Breakdown ToBreakdown(const BreakdownLite& bdl) {
+  Breakdown bd;
+  bd.year = bdl.year;
+  bd.month = bdl.month;
+  bd.day = bdl.day;
+  bd.hour = bdl.hour;
+  bd.minute = bdl.minute;
+  bd.second = bdl.second;
+  bd.subsecond = bdl.subsecond;
+  bd.weekday = bdl.weekday;
+  bd.yearday = bdl.yearday;
+  bd.offset = bdl.offset;
+  bd.is_dst = bdl.is_dst;
+  bd.abbr = bdl.abbr;
+  return bd;
+}
+
+}  // namespace
+
 Breakdown BreakTime(const time_point& tp, const TimeZone& tz) {
-  return TimeZone::Impl::get(tz).BreakTime(tp);
+  return ToBreakdown(BreakTimeLite(tp, tz));
+}
+
+Breakdown BreakTime(int64_t unix_seconds, std::chrono::nanoseconds subsecond,
+                    const TimeZone& tz) {
+  return ToBreakdown(BreakTimeLite(unix_seconds, subsecond, tz));
+}
+
+BreakdownLite BreakTimeLite(const time_point& tp, const TimeZone& tz) {
+  int64_t unix_time;
+  duration subsecond;
+  SplitUnixTime(tp, &unix_time, &subsecond);
+  BreakdownLite bd = TimeZone::Impl::BreakTime(tz, unix_time);
+  bd.subsecond = subsecond;
+  return bd;
+}
+
+BreakdownLite BreakTimeLite(int64_t unix_seconds,
+                            std::chrono::nanoseconds subsecond,
+                            const TimeZone& tz) {
+  if (subsecond < std::chrono::nanoseconds::zero() ||
+      subsecond >= std::chrono::seconds(1)) {
+    const std::chrono::seconds carry =
+        std::chrono::duration_cast<std::chrono::seconds>(subsecond);
+    unix_seconds += carry.count();
+    subsecond -= carry;
+    if (subsecond < std::chrono::nanoseconds::zero()) {
+      unix_seconds -= 1;
+      subsecond += std::chrono::seconds(1);
+    }
+  }
+  BreakdownLite bd = TimeZone::Impl::BreakTime(tz, unix_seconds);
+  bd.subsecond = subsecond;
+  return bd;
+}
+
+void BreakTimes(const int64_t* unix_seconds, std::size_t n,
+                const TimeZone& tz, const BreakdownColumns& out) {
+  BreakdownColumns cols = out;
+  cols.subsecond = nullptr;
+  TimeZone::Impl::BreakTimes(tz, unix_seconds, n, cols);
+  if (out.subsecond != nullptr) {
+    std::fill(out.subsecond, out.subsecond + n, duration::zero());
+  }
+}
+
+void BreakTimes(const time_point* tps, std::size_t n,
+                const TimeZone& tz, const BreakdownColumns& out) {
+  // Split the times into seconds and subseconds a block at a time, and
+  // convert the seconds using the columns offset to the current block.
+  const std::size_t kBlockSize = 256;
+  int64_t unix_seconds[kBlockSize];
+  for (std::size_t base = 0; base < n; base += kBlockSize) {
+    const std::size_t m = std::min(kBlockSize, n - base);
+    for (std::size_t i = 0; i != m; ++i) {
+      duration subsecond;
+      SplitUnixTime(tps[base + i], &unix_seconds[i], &subsecond);
+      if (out.subsecond != nullptr) out.subsecond[base + i] = subsecond;
+    }
+    BreakdownColumns block = out;
+    block.subsecond = nullptr;
+    if (block.year != nullptr) block.year += base;
+    if (block.month != nullptr) block.month += base;
+    if (block.day != nullptr) block.day += base;
+    if (block.hour != nullptr) block.hour += base;
+    if (block.minute != nullptr) block.minute += base;
+    if (block.second != nullptr) block.second += base;
+    if (block.weekday != nullptr) block.weekday += base;
+    if (block.yearday != nullptr) block.yearday += base;
+    if (block.offset != nullptr) block.offset += base;
+    if (block.is_dst != nullptr) block.is_dst += base;
+    if (block.abbr != nullptr) block.abbr += base;
+    TimeZone::Impl::BreakTimes(tz, unix_seconds, m, block);
+  }
 }
 
 time_point MakeTime(int64_t year, int mon, int day,
@@ -58,7 +181,93 @@ time_point MakeTime(int64_t year, int mon, int day,
 TimeInfo MakeTimeInfo(int64_t year, int mon, int day,
                       int hour, int min, int sec,
                       const TimeZone& tz) {
-  return TimeZone::Impl::get(tz).MakeTimeInfo(year, mon, day, hour, min, sec);
+  return TimeZone::Impl::MakeTimeInfo(tz, year, mon, day, hour, min, sec);
+}
+
+void MakeTimes(const CivilColumns& civil, std::size_t n, const TimeZone& tz,
+               int64_t* unix_seconds, TimeInfo::Kind* kinds) {
+  TimeZone::Impl::MakeTimes(tz, civil, n, unix_seconds, kinds);
+}
+
+void MakeTimes(const CivilColumns& civil, std::size_t n, const TimeZone& tz,
+               time_point* tps, TimeInfo::Kind* kinds) {
+  // Convert a block of rows at a time into seconds, using the columns
+  // offset to the current block.
+  const std::size_t kBlockSize = 256;
+  int64_t unix_seconds[kBlockSize];
+  for (std::size_t base = 0; base < n; base += kBlockSize) {
+    const std::size_t m = std::min(kBlockSize, n - base);
+    CivilColumns block = civil;
+    block.year += base;
+    block.month += base;
+    block.day += base;
+    if (block.hour != nullptr) block.hour += base;
+    if (block.minute != nullptr) block.minute += base;
+    if (block.second != nullptr) block.second += base;
+    TimeZone::Impl::MakeTimes(tz, block, m, unix_seconds,
+                              kinds == nullptr ? nullptr : kinds + base);
+    for (std::size_t i = 0; i != m; ++i) {
+      tps[base + i] = FromUnixSeconds(unix_seconds[i]);
+    }
+  }
+}
+
+time_point StartOfDay(const time_point& tp, const TimeZone& tz) {
+  int64_t unix_time;
+  duration subsecond;
+  SplitUnixTime(tp, &unix_time, &subsecond);
+  return FromUnixSeconds(StartOfDay(unix_time, tz));
+}
+
+time_point StartOfHour(const time_point& tp, const TimeZone& tz) {
+  int64_t unix_time;
+  duration subsecond;
+  SplitUnixTime(tp, &unix_time, &subsecond);
+  return FromUnixSeconds(StartOfHour(unix_time, tz));
+}
+
+int64_t StartOfDay(int64_t unix_seconds, const TimeZone& tz) {
+  return TimeZone::Impl::StartOfSpan(tz, unix_seconds, kSecsPerDay);
+}
+
+int64_t StartOfHour(int64_t unix_seconds, const TimeZone& tz) {
+  return TimeZone::Impl::StartOfSpan(tz, unix_seconds, kSecsPerHour);
+}
+
+bool NextTransition(const time_point& tp, const TimeZone& tz,
+                    time_point* trans) {
+  int64_t unix_time;
+  duration subsecond;
+  SplitUnixTime(tp, &unix_time, &subsecond);
+  int64_t trans_time;
+  if (!NextTransition(unix_time, tz, &trans_time)) return false;
+  *trans = FromUnixSeconds(trans_time);
+  return true;
+}
+
+bool PrevTransition(const time_point& tp, const TimeZone& tz,
+                    time_point* trans) {
+  int64_t unix_time;
+  duration subsecond;
+  SplitUnixTime(tp, &unix_time, &subsecond);
+  if (subsecond != duration::zero() &&
+      unix_time != std::numeric_limits<int64_t>::max()) {
+    unix_time += 1;  // a transition at unix_time itself is before tp
+  }
+  int64_t trans_time;
+  if (!PrevTransition(unix_time, tz, &trans_time)) return false;
+  *trans = FromUnixSeconds(trans_time);
+  return true;
+}
+
+bool NextTransition(int64_t unix_seconds, const TimeZone& tz,
+                    int64_t* trans) {
+  return TimeZone::Impl::NextTransition(tz, unix_seconds, trans);
+}
+
+bool PrevTransition(int64_t unix_seconds, const TimeZone& tz,
+                    int64_t* trans) {
+  return TimeZone::Impl::PrevTransition(tz, unix_seconds, trans);
 }
 
 }  // namespace cctz
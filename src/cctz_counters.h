@@ -0,0 +1,113 @@
+// Copyright 2015 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+//     Unless required by applicable law or agreed to in writing, software
+//     distributed under the License is distributed on an "AS IS" BASIS,
+//     WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+//     implied.
+//     See the License for the specific language governing permissions and
+//     limitations under the License.
+
+// The counters behind cctz_stats.h, which are only kept when CCTZ_STATS is
+// defined. Otherwise the counting functions are empty, and compile away.
+
+#ifndef CCTZ_COUNTERS_H_
+#define CCTZ_COUNTERS_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace cctz {
+
+// The counters kept for each zone, as described by ZoneStats.
+enum ZoneCounter {
+  kLoads,
+  kLoadNanos,
+  kBreakTime,
+  kBreakTimesRows,
+  kBreakTimesSearches,
+  kMakeTime,
+  kMakeTimesRows,
+  kMakeTimesSearches,
+  kMakeTimesFallbacks,
+  kFutureShifts,
+  kNumZoneCounters
+};
+
+// The counters kept for the library as a whole, as described by Stats.
+enum GlobalCounter {
+  kStrftimeFallbacks,
+  kStrptimeFallbacks,
+  kUTCFallbacks,
+  kNumGlobalCounters
+};
+
+// Returns the shard of the calling thread, which is fixed for its life.
+// Threads take the shards in turn, so that up to kCounterShards threads
+// never share one.
+const std::size_t kCounterShards = 16;
+inline std::size_t CounterShard() {
+  static std::atomic<std::size_t> next_shard(0);
+  static thread_local const std::size_t shard =
+      next_shard.fetch_add(1, std::memory_order_relaxed) % kCounterShards;
+  return shard;
+}
+
+// N counters, each split into a relaxed atomic per shard, with every
+// shard padded to a whole number of cache lines. (The shards themselves
+// are not over-aligned, as C++11 new cannot allocate them so.)
+template <int N>
+class ShardedCounters {
+ public:
+  ShardedCounters() {
+    for (Shard& shard : shards_) {
+      for (std::atomic<uint64_t>& count : shard.counts) count.store(0);
+    }
+  }
+
+  void Add(int counter, uint64_t n) {
+    shards_[CounterShard()].counts[counter].fetch_add(
+        n, std::memory_order_relaxed);
+  }
+
+  // Returns the sum of the shards, which is only a snapshot of each.
+  uint64_t Sum(int counter) const {
+    uint64_t sum = 0;
+    for (const Shard& shard : shards_) {
+      sum += shard.counts[counter].load(std::memory_order_relaxed);
+    }
+    return sum;
+  }
+
+ private:
+  static const std::size_t kCacheLine = 64;
+  struct Shard {
+    std::atomic<uint64_t> counts[N];
+    char padding[kCacheLine - sizeof(std::atomic<uint64_t>[N]) % kCacheLine];
+  };
+  Shard shards_[kCounterShards];
+};
+
+using ZoneCounters = ShardedCounters<kNumZoneCounters>;
+
+// The library-wide counters.
+ShardedCounters<kNumGlobalCounters>& GlobalCounters();
+
+// Adds n to a library-wide counter.
+#ifdef CCTZ_STATS
+inline void CountGlobal(GlobalCounter counter, uint64_t n = 1) {
+  GlobalCounters().Add(counter, n);
+}
+#else
+inline void CountGlobal(GlobalCounter, uint64_t = 1) {}
+#endif
+
+}  // namespace cctz
+
+#endif  // CCTZ_COUNTERS_H_
@@ -0,0 +1,100 @@
+// Copyright 2015 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+//     Unless required by applicable law or agreed to in writing, software
+//     distributed under the License is distributed on an "AS IS" BASIS,
+//     WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+//     implied.
+//     See the License for the specific language governing permissions and
+//     limitations under the License.
+
+// Proleptic Gregorian calendar arithmetic on day ordinals (the number of
+// days before/after 1970-01-01), shared by the time-zone implementations
+// and the fast paths of formatting and parsing.
+
+#ifndef CCTZ_DAYS_H_
+#define CCTZ_DAYS_H_
+
+#include <cstdint>
+
+namespace cctz {
+
+inline bool IsLeap(int64_t year) {
+  return year % 4 == 0 && (year % 100 != 0 || year % 400 == 0);
+}
+
+// The month lengths in non-leap and leap years respectively.
+const int8_t kDaysPerMonth[2][1 + 12] = {
+  {-1, 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31},
+  {-1, 31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31},
+};
+
+// Map a (normalized) Y/M/D to the number of days before/after 1970-01-01.
+// T is any signed type wide enough for the result (e.g., __int128 where
+// the year may be near the limits of int64_t).
+// See http://howardhinnant.github.io/date_algorithms.html#days_from_civil.
+template <typename T>
+inline T DayOrdinal(T year, int month, int day) {
+  year -= (month <= 2 ? 1 : 0);
+  const T era = (year >= 0 ? year : year - 399) / 400;
+  const int yoe = static_cast<int>(year - era * 400);
+  const int doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+  const int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + doe - 719468;  // shift epoch to 1970-01-01
+}
+
+// The civil date of a day ordinal.
+struct CivilDate {
+  int64_t year;
+  int month;    // [1:12]
+  int day;      // [1:31]
+  int weekday;  // 1==Mon, ..., 7=Sun
+  int yearday;  // [1:366]
+};
+
+// The inverse of DayOrdinal(), plus the weekday and yearday. There are no
+// data-dependent branches or table lookups, so a loop of these can be
+// vectorized by the compiler. See
+// http://howardhinnant.github.io/date_algorithms.html#civil_from_days.
+inline CivilDate CivilFromDays(int64_t days) {
+  const int64_t z = days + 719468;  // shift epoch to 0000-03-01
+  const int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+  const int doe = static_cast<int>(z - era * 146097);  // [0, 146096]
+  const int yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  const int doy = doe - (365 * yoe + yoe / 4 - yoe / 100);  // [0, 365]
+  const int mp = (5 * doy + 2) / 153;  // [0, 11], starting in March
+  const int jan_feb = (mp >= 10);
+  const int leap = (yoe % 4 == 0 && yoe % 100 != 0) || yoe == 0;
+  CivilDate cd;
+  cd.year = era * 400 + yoe + jan_feb;
+  cd.month = mp + (jan_feb ? -9 : 3);
+  cd.day = doy - (153 * mp + 2) / 5 + 1;
+  cd.yearday = doy + (jan_feb ? -305 : 60 + leap);
+  // 400-year eras have a whole number of weeks, and 0000-03-01 was a Wed.
+  cd.weekday = (doe + 2) % 7 + 1;
+  return cd;
+}
+
+// Splits the local time (unix_time + utc_offset) into a day ordinal and
+// a second of that day. This is done piecewise so that the sum of the
+// two cannot overflow.
+inline void SplitLocalTime(int64_t unix_time, int32_t utc_offset,
+                           int64_t* days, int* sod) {
+  const int64_t kDay = 24 * 60 * 60;
+  int64_t secs = unix_time % kDay + utc_offset;
+  int64_t d = unix_time / kDay + secs / kDay;
+  secs %= kDay;
+  d -= (secs < 0) ? 1 : 0;
+  secs += (secs < 0) ? kDay : 0;
+  *days = d;
+  *sod = static_cast<int>(secs);
+}
+
+}  // namespace cctz
+
+#endif  // CCTZ_DAYS_H_
@@ -0,0 +1,197 @@
+// Copyright 2015 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+//     Unless required by applicable law or agreed to in writing, software
+//     distributed under the License is distributed on an "AS IS" BASIS,
+//     WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+//     implied.
+//     See the License for the specific language governing permissions and
+//     limitations under the License.
+
+#include "src/cctz_fixed.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <limits>
+
+#include "src/cctz_days.h"
+#include "src/cctz_info.h"
+
+namespace cctz {
+
+namespace {
+
+// Years whose seconds are comfortably representable in 64 bits.
+const int64_t kMaxFastYear = 1000000000;
+
+// Breaks the local time (unix_time + offset) down into the civil fields
+// of bd.
+void CivilFromTime(int64_t unix_time, int32_t offset, BreakdownLite* bd) {
+  int64_t days;
+  int sod;
+  SplitLocalTime(unix_time, offset, &days, &sod);
+  const CivilDate cd = CivilFromDays(days);
+  bd->year = cd.year;
+  bd->month = cd.month;
+  bd->day = cd.day;
+  bd->weekday = cd.weekday;
+  bd->yearday = cd.yearday;
+  bd->hour = sod / (60 * 60);
+  bd->minute = sod / 60 % 60;
+  bd->second = sod % 60;
+}
+
+// Parses the 2-digit field at *np within [*np ... ep) (or 1 or 2 digits if
+// not exact), which must be less than limit.
+bool ParseField(const char** np, const char* ep, bool exact, int limit,
+                int* vp) {
+  const char* p = *np;
+  int v = 0;
+  for (int n = 0; n != 2; ++n) {
+    if (p == ep || *p < '0' || *p > '9') {
+      if (n == 0 || exact) return false;
+      break;
+    }
+    v = v * 10 + (*p++ - '0');
+  }
+  if (v >= limit) return false;
+  *np = p;
+  *vp = v;
+  return true;
+}
+
+// Formats an offset as zoneinfo abbreviates it: "+hh", "+hhmm" or "+hhmmss".
+std::string OffsetAbbr(int32_t offset) {
+  std::string abbr(1, offset < 0 ? '-' : '+');
+  if (offset < 0) offset = -offset;
+  const int fields[3] = {offset / 3600, offset / 60 % 60, offset % 60};
+  const int nfields = (fields[2] != 0) ? 3 : (fields[1] != 0) ? 2 : 1;
+  for (int i = 0; i != nfields; ++i) {
+    abbr += static_cast<char>('0' + fields[i] / 10);
+    abbr += static_cast<char>('0' + fields[i] % 10);
+  }
+  return abbr;
+}
+
+}  // namespace
+
+bool ParseFixedOffset(const std::string& name, int32_t* offset,
+                      std::string* abbr) {
+  const char* p = name.c_str();
+  const char* const ep = p + name.size();
+  if (name.compare(0, 7, "Etc/GMT") == 0) {
+    p += 7;
+    if (p == ep || (*p != '+' && *p != '-')) return false;
+    const bool east = (*p++ == '-');  // inverted, as in POSIX
+    int hours;
+    if (!ParseField(&p, ep, false, east ? 15 : 13, &hours) || p != ep)
+      return false;
+    if (p - name.c_str() != (hours < 10 ? 9 : 10)) return false;  // "+05"
+    *offset = (east ? hours : -hours) * 3600;
+    *abbr = (hours == 0) ? "GMT" : OffsetAbbr(*offset);
+    return true;
+  }
+  if (name.compare(0, 3, "UTC") == 0) {
+    p += 3;
+    if (p == ep || (*p != '+' && *p != '-')) return false;
+    const bool east = (*p++ == '+');
+    int fields[3] = {0, 0, 0};
+    if (!ParseField(&p, ep, false, 24, &fields[0])) return false;
+    for (int i = 1; i != 3 && p != ep; ++i) {
+      if (*p++ != ':' || !ParseField(&p, ep, true, 60, &fields[i]))
+        return false;
+    }
+    if (p != ep) return false;
+    const int32_t secs = fields[0] * 3600 + fields[1] * 60 + fields[2];
+    *offset = east ? secs : -secs;
+    *abbr = (secs == 0) ? "UTC" : OffsetAbbr(*offset);
+    return true;
+  }
+  return false;
+}
+
+TimeInfo FixedOffsetTimeInfo(int64_t year, int mon, int day,
+                             int hour, int min, int sec, int32_t offset) {
+  TimeInfo ti;
+  ti.kind = TimeInfo::Kind::UNIQUE;
+  ti.normalized = false;
+
+  // In-range fields (the usual case) need no normalization, and their
+  // seconds fit in 64 bits.
+  if (-kMaxFastYear <= year && year <= kMaxFastYear &&
+      1 <= mon && mon <= 12 && 1 <= day &&
+      day <= kDaysPerMonth[IsLeap(year)][mon] &&
+      0 <= hour && hour < 24 && 0 <= min && min < 60 &&
+      0 <= sec && sec < 60) {
+    const int64_t unix_time = DayOrdinal(year, mon, day) * kSecsPerDay +
+                              hour * 3600 + min * 60 + sec - offset;
+    ti.pre = ti.trans = ti.post = FromUnixSeconds(unix_time);
+    return ti;
+  }
+
+  // Otherwise normalize in 128 bits, saturating at the limits of time_t.
+  DateTime dt;
+  ti.normalized = dt.Normalize(year, mon, day, hour, min, sec);
+  __int128 unix_time = (dt - DateTime{0}) - offset;
+  const std::time_t tmax = std::numeric_limits<std::time_t>::max();
+  const std::time_t tmin = std::numeric_limits<std::time_t>::min();
+  if (unix_time > tmax || unix_time < tmin) {
+    ti.normalized = true;
+    unix_time = (unix_time < 0) ? tmin : tmax;
+  }
+  ti.pre = ti.trans = ti.post =
+      FromUnixSeconds(static_cast<int64_t>(unix_time));
+  return ti;
+}
+
+TimeZoneFixed::TimeZoneFixed(int32_t offset, const std::string& abbr)
+    : TimeZoneIf(Kind::kFixed), offset_(offset) {
+  const std::size_t len = std::min(abbr.size(), kMaxAbbr - 1);
+  std::memcpy(abbr_, abbr.data(), len);
+  abbr_[len] = '\0';
+}
+
+BreakdownLite TimeZoneFixed::BreakTime(int64_t unix_time) const {
+  BreakdownLite bd;
+  CivilFromTime(unix_time, offset_, &bd);
+  bd.subsecond = duration::zero();
+  bd.offset = offset_;
+  bd.is_dst = false;
+  bd.abbr = abbr_;
+  return bd;
+}
+
+void TimeZoneFixed::BreakTimes(const int64_t* unix_seconds, std::size_t n,
+                               const BreakdownColumns& out) const {
+  for (std::size_t i = 0; i != n; ++i) {
+    BreakdownLite bd;
+    CivilFromTime(unix_seconds[i], offset_, &bd);
+    bd.subsecond = duration::zero();
+    bd.offset = offset_;
+    bd.is_dst = false;
+    bd.abbr = abbr_;
+    StoreBreakdown(bd, i, out);
+  }
+}
+
+int64_t TimeZoneFixed::StartOfSpan(int64_t unix_time, int64_t span) const {
+  const int64_t r = SecondsIntoSpan(unix_time, offset_, span);
+  if (unix_time < std::numeric_limits<int64_t>::min() + r) {
+    return TimeZoneIf::StartOfSpan(unix_time, span);
+  }
+  return unix_time - r;
+}
+
+TimeInfo TimeZoneFixed::MakeTimeInfo(int64_t year, int mon, int day,
+                                     int hour, int min, int sec) const {
+  return FixedOffsetTimeInfo(year, mon, day, hour, min, sec, offset_);
+}
+
+}  // namespace cctz
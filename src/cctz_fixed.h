@@ -0,0 +1,69 @@
+// Copyright 2015 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+//     Unless required by applicable law or agreed to in writing, software
+//     distributed under the License is distributed on an "AS IS" BASIS,
+//     WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+//     implied.
+//     See the License for the specific language governing permissions and
+//     limitations under the License.
+
+#ifndef CCTZ_FIXED_H_
+#define CCTZ_FIXED_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "src/cctz_if.h"
+
+namespace cctz {
+
+// Returns whether the name is that of a fixed offset from UTC, either of
+// the form "UTC+hh[:mm[:ss]]" (or "UTC-...") for offsets of less than a
+// day, or one of the zoneinfo names "Etc/GMT-14" ... "Etc/GMT+12" (where,
+// as in POSIX, the sign is inverted). If so, sets *offset to the seconds
+// east of UTC, and *abbr to the abbreviation used by zoneinfo for such an
+// offset (e.g., "+0530", or "-05").
+bool ParseFixedOffset(const std::string& name, int32_t* offset,
+                      std::string* abbr);
+
+// Converts civil time in a fixed UTC offset, as MakeTimeInfo() would if
+// given a TimeZoneFixed of that offset. The result is always UNIQUE.
+TimeInfo FixedOffsetTimeInfo(int64_t year, int mon, int day,
+                             int hour, int min, int sec, int32_t offset);
+
+// A time zone with a fixed offset from UTC, where conversions are pure
+// arithmetic.
+class TimeZoneFixed final : public TimeZoneIf {
+ public:
+  // UTC itself, which (unlike the other offsets) may be constant initialized.
+  constexpr TimeZoneFixed()
+      : TimeZoneIf(Kind::kFixed), offset_(0), abbr_{'U', 'T', 'C', '\0'} {}
+
+  // The abbreviation must be shorter than kMaxAbbr.
+  TimeZoneFixed(int32_t offset, const std::string& abbr);
+
+  // TimeZoneIf implementations.
+  BreakdownLite BreakTime(int64_t unix_time) const override;
+  void BreakTimes(const int64_t* unix_seconds, std::size_t n,
+                  const BreakdownColumns& out) const override;
+  TimeInfo MakeTimeInfo(int64_t year, int mon, int day,
+                        int hour, int min, int sec) const override;
+  int64_t StartOfSpan(int64_t unix_time, int64_t span) const override;
+
+ private:
+  static const std::size_t kMaxAbbr = 8;  // e.g., "+hhmmss" and a NUL
+
+  const int32_t offset_;  // seconds east of UTC
+  char abbr_[kMaxAbbr];   // e.g., "+0530"
+};
+
+}  // namespace cctz
+
+#endif  // CCTZ_FIXED_H_
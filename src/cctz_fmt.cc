@@ -15,18 +15,28 @@
 
 #include "src/cctz.h"
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <clocale>
 #include <cstdint>
 #include <cstring>
 #include <ctime>
 #include <limits>
+#include <memory>
+#include <string>
 #include <vector>
 
+#include "src/cctz_counters.h"
+#include "src/cctz_days.h"
+#include "src/cctz_fixed.h"
+#include "src/cctz_impl.h"
+
 namespace cctz {
 
 namespace {
 
-std::tm ToTM(const Breakdown& bd) {
+std::tm ToTM(const BreakdownLite& bd) {
   std::tm tm = {0};
   tm.tm_sec = bd.second;
   tm.tm_min = bd.minute;
@@ -102,32 +112,34 @@ char* FormatOffset(char* ep, int minutes, char sep) {
   return ep;
 }
 
-// Formats a std::tm using strftime(3).
-void FormatTM(std::string* out, const std::string& fmt, const std::tm& tm) {
+// Formats a std::tm using strftime(3), into *buf, returning the length.
+// The format is the NUL-terminated fmt, of length len.
+size_t FormatTM(std::vector<char>* buf, const char* fmt, size_t len,
+                const std::tm& tm) {
   // strftime(3) returns the number of characters placed in the output
   // array (which may be 0 characters).  It also returns 0 to indicate
   // an error, like the array wasn't large enough.  To accomodate this,
   // the following code grows the buffer size from 2x the format string
   // length up to 32x.
   for (int i = 2; i != 32; i *= 2) {
-    size_t buf_size = fmt.size() * i;
-    std::vector<char> buf(buf_size);
-    if (size_t len = strftime(&buf[0], buf_size, fmt.c_str(), &tm)) {
-      out->append(&buf[0], len);
-      return;
-    }
+    size_t buf_size = len * i;
+    buf->resize(buf_size);
+    if (size_t n = strftime(buf->data(), buf_size, fmt, &tm)) return n;
   }
+  return 0;
 }
 
-// Used for %E#S specifiers and for data values in Parse().
+// Used for %E#S specifiers and for data values in Parse(). The input ends
+// at ep (or at a non-digit, as when NUL terminated).
 template <typename T>
-const char* ParseInt(const char* dp, int width, T min, T max, T* vp) {
+const char* ParseInt(const char* dp, const char* ep, int width,
+                     T min, T max, T* vp) {
   if (dp != nullptr) {
     const T kmin = std::numeric_limits<T>::min();
     bool erange = false;
     bool neg = false;
     T value = 0;
-    if (*dp == '-') {
+    if (dp != ep && *dp == '-') {
       neg = true;
       if (width <= 0 || --width != 0) {
         ++dp;
@@ -136,9 +148,9 @@ const char* ParseInt(const char* dp, int width, T min, T max, T* vp) {
       }
     }
     if (const char* const bp = dp) {
-      while (const char* cp = strchr(kDigits, *dp)) {
-        int d = static_cast<int>(cp - kDigits);
-        if (d >= 10) break;
+      while (dp != ep) {
+        const int d = static_cast<unsigned char>(*dp) - '0';
+        if (d < 0 || d >= 10) break;
         if (value < kmin / 10) {
           erange = true;
           break;
@@ -197,39 +209,76 @@ const int64_t kExp10[kDigits10_64 + 1] = {
     1000000000000000000,
 };
 
+// The C/POSIX-locale names of the weekdays (from Sunday) and months.
+const char* const kWeekdayNames[] = {
+    "Sunday", "Monday", "Tuesday", "Wednesday",
+    "Thursday", "Friday", "Saturday",
+};
+const char* const kMonthNames[] = {
+    "January", "February", "March", "April", "May", "June",
+    "July", "August", "September", "October", "November", "December",
+};
+
+// Whether LC_TIME is the C/POSIX locale, in which case the locale-specific
+// conversions are known. Note that this consults the global locale, and so
+// does not notice any per-thread locale installed by uselocale(3).
+bool IsCLocale() {
+  const char* name = std::setlocale(LC_TIME, nullptr);
+  return name != nullptr &&
+         (std::strcmp(name, "C") == 0 || std::strcmp(name, "POSIX") == 0);
+}
+
+// The state needed to fall back to strftime(3), computed on first use.
+class StrftimeState {
+ public:
+  explicit StrftimeState(const BreakdownLite& bd) : bd_(bd) {}
+
+  const std::tm& tm() {
+    if (!have_tm_) {
+      tm_ = ToTM(bd_);
+      have_tm_ = true;
+    }
+    return tm_;
+  }
+
+  bool c_locale() {
+    if (c_locale_ < 0) c_locale_ = IsCLocale() ? 1 : 0;
+    return c_locale_ != 0;
+  }
+
+ private:
+  const BreakdownLite& bd_;
+  std::tm tm_;
+  bool have_tm_ = false;
+  int c_locale_ = -1;  // unknown
+};
+
 }  // namespace
 
-// Uses strftime(3) to format the given Time.  The following extended format
-// specifiers are also supported:
+// Compiles a format for strftime(3)-style formatting.  The following extended
+// format specifiers are also supported:
 //
 //   - %Ez  - RFC3339-compatible numeric timezone (+hh:mm or -hh:mm)
 //   - %E#S - Seconds with # digits of fractional precision
 //   - %E*S - Seconds with full fractional precision (a literal '*')
 //   - %E4Y - Four-character years (-999 ... -001, 0000, 0001 ... 9999)
 //
-// The standard specifiers from RFC3339_* (%Y, %m, %d, %H, %M, and %S) are
-// handled internally for performance reasons.  strftime(3) is slow due to
-// a POSIX requirement to respect changes to ${TZ}.
+// The standard specifiers from RFC3339_* (%Y, %m, %d, %H, %M, and %S), and
+// the other locale-independent POSIX specifiers, are handled internally for
+// performance reasons.  strftime(3) is slow due to a POSIX requirement to
+// respect changes to ${TZ}, and due to the std::tm round trip.  The locale-
+// specific names (%a, %A, %b, %B, %p, ...) are also handled internally when
+// LC_TIME is the C locale.  Everything else is left to strftime(3).
 //
 // The TZ/GNU %s extension is handled internally because strftime() has
 // to use mktime() to generate it, and that assumes the local time zone.
 //
 // We also handle the %z and %Z specifiers to accommodate platforms that do
 // not support the tm_gmtoff and tm_zone extensions to std::tm.
-std::string Format(const std::string& format, const time_point& tp,
-                   const TimeZone& tz) {
-  std::string result;
-  const Breakdown bd = BreakTime(tp, tz);
-  const std::tm tm = ToTM(bd);
-
-  // Scratch buffer for internal conversions.
-  char buf[3 + kDigits10_64];  // enough for longest conversion
-  char* const ep = buf + sizeof(buf);
-  char* bp;  // works back from ep
-
+CompiledFormat::CompiledFormat(const std::string& format) {
   // Maintain three, disjoint subsequences that span format.
-  //   [format.begin() ... pending) : already formatted into result
-  //   [pending ... cur) : formatting pending, but no special cases
+  //   [format.begin() ... pending) : already compiled into ops_
+  //   [pending ... cur) : compilation pending, but no special cases
   //   [cur ... format.end()) : unexamined
   // Initially, everything is in the unexamined part.
   const char* pending = format.c_str();  // NUL terminated
@@ -243,7 +292,7 @@ std::string Format(const std::string& format, const time_point& tp,
 
     // If the new pending text is all ordinary, copy it out.
     if (cur != start && pending == start) {
-      result.append(pending, cur - pending);
+      AddText(OpKind::kLiteral, pending, cur - pending);
       pending = start = cur;
     }
 
@@ -255,11 +304,11 @@ std::string Format(const std::string& format, const time_point& tp,
     // percent for every matched pair, then skip those pairs.
     if (cur != start && pending == start) {
       size_t escaped = (cur - pending) / 2;
-      result.append(pending, escaped);
+      AddText(OpKind::kLiteral, pending, escaped);
       pending += escaped * 2;
       // Also copy out a single trailing percent.
       if (pending != cur && cur == end) {
-        result.push_back(*pending++);
+        AddText(OpKind::kLiteral, pending++, 1);
       }
     }
 
@@ -267,53 +316,55 @@ std::string Format(const std::string& format, const time_point& tp,
     if (cur == end || (cur - percent) % 2 == 0) continue;
 
     // Simple specifiers that we handle ourselves.
-    if (strchr("YmdeHMSzZs", *cur)) {
+    bool native = true;
+    bool c_locale = false;
+    OpKind kind = OpKind::kLiteral;  // for %n and %t
+    switch (*cur) {
+      case 'Y':
+        // This avoids the tm_year overflow problem for %Y, however
+        // tm.tm_year will still be used by other specifiers like %c.
+        kind = OpKind::kYear;
+        break;
+      case 'y': kind = OpKind::kYear2; break;
+      case 'C': kind = OpKind::kCentury; break;
+      case 'm': kind = OpKind::kMonth; break;
+      case 'd': kind = OpKind::kDay; break;
+      case 'e': kind = OpKind::kDaySpace; break;
+      case 'j': kind = OpKind::kYearDay; break;
+      case 'u': kind = OpKind::kWeekdayMon; break;
+      case 'w': kind = OpKind::kWeekdaySun; break;
+      case 'U': kind = OpKind::kWeekSun; break;
+      case 'W': kind = OpKind::kWeekMon; break;
+      case 'H': kind = OpKind::kHour; break;
+      case 'I': kind = OpKind::kHour12; break;
+      case 'M': kind = OpKind::kMinute; break;
+      case 'S': kind = OpKind::kSecond; break;
+      case 'F': kind = OpKind::kDate; break;
+      case 'D': kind = OpKind::kDateSlash; break;
+      case 'T': kind = OpKind::kTime; break;
+      case 'R': kind = OpKind::kHourMinute; break;
+      case 'z': kind = OpKind::kOffset; break;
+      case 'Z': kind = OpKind::kAbbr; break;
+      case 's': kind = OpKind::kUnixSeconds; break;
+      case 'n': case 't': break;
+      case 'x': kind = OpKind::kDateSlash; c_locale = true; break;
+      case 'X': kind = OpKind::kTime; c_locale = true; break;
+      case 'r': kind = OpKind::kTime12; c_locale = true; break;
+      case 'a': kind = OpKind::kWeekdayShort; c_locale = true; break;
+      case 'A': kind = OpKind::kWeekdayLong; c_locale = true; break;
+      case 'b': case 'h': kind = OpKind::kMonthShort; c_locale = true; break;
+      case 'B': kind = OpKind::kMonthLong; c_locale = true; break;
+      case 'p': kind = OpKind::kAmPm; c_locale = true; break;
+      default: native = false; break;
+    }
+    if (native) {
       if (cur - 1 != pending) {
-        FormatTM(&result, std::string(pending, cur - 1), tm);
+        AddText(OpKind::kStrftime, pending, cur - 1 - pending);
       }
-      switch (*cur) {
-        case 'Y':
-          // This avoids the tm_year overflow problem for %Y, however
-          // tm.tm_year will still be used by other specifiers like %D.
-          bp = Format64(ep, 0, bd.year);
-          result.append(bp, ep - bp);
-          break;
-        case 'm':
-          bp = Format02d(ep, bd.month);
-          result.append(bp, ep - bp);
-          break;
-        case 'd':
-        case 'e':
-          bp = Format02d(ep, bd.day);
-          if (*cur == 'e' && *bp == '0') *bp = ' ';  // for Windows
-          result.append(bp, ep - bp);
-          break;
-        case 'H':
-          bp = Format02d(ep, bd.hour);
-          result.append(bp, ep - bp);
-          break;
-        case 'M':
-          bp = Format02d(ep, bd.minute);
-          result.append(bp, ep - bp);
-          break;
-        case 'S':
-          bp = Format02d(ep, bd.second);
-          result.append(bp, ep - bp);
-          break;
-        case 'z':
-          bp = FormatOffset(ep, bd.offset / 60, '\0');
-          result.append(bp, ep - bp);
-          break;
-        case 'Z':
-          result.append(bd.abbr);
-          break;
-        case 's':
-          bp = Format64(
-              ep, 0, std::chrono::duration_cast<std::chrono::duration<int64_t>>(
-                         tp - std::chrono::system_clock::from_time_t(0))
-                         .count());
-          result.append(bp, ep - bp);
-          break;
+      if (kind == OpKind::kLiteral) {
+        AddText(OpKind::kLiteral, (*cur == 'n') ? "\n" : "\t", 1);
+      } else {
+        AddOp(kind, 0, c_locale, cur - 1, 2);
       }
       pending = ++cur;
       continue;
@@ -322,82 +373,454 @@ std::string Format(const std::string& format, const time_point& tp,
     // Loop if there is no E modifier.
     if (*cur != 'E' || ++cur == end) continue;
 
-    // Format our extensions.
+    // Compile our extensions.
     if (*cur == 'z') {
-      // Formats %Ez.
+      // Compiles %Ez.
       if (cur - 2 != pending) {
-        FormatTM(&result, std::string(pending, cur - 2), tm);
+        AddText(OpKind::kStrftime, pending, cur - 2 - pending);
       }
-      bp = FormatOffset(ep, bd.offset / 60, ':');
-      result.append(bp, ep - bp);
+      AddOp(OpKind::kOffsetColon, 0, false, cur - 2, 3);
       pending = ++cur;
     } else if (*cur == '*' && cur + 1 != end && *(cur + 1) == 'S') {
-      // Formats %E*S.
+      // Compiles %E*S.
       if (cur - 2 != pending) {
-        FormatTM(&result, std::string(pending, cur - 2), tm);
+        AddText(OpKind::kStrftime, pending, cur - 2 - pending);
       }
-      char* cp = ep;
-      const int64_t nanoseconds = bd.subsecond.count();
-      bp = Format64(cp, 9, nanoseconds);
-      while (cp != bp && cp[-1] == '0') --cp;
-      if (cp != bp) *--bp = '.';
-      bp = Format02d(bp, bd.second);
-      result.append(bp, cp - bp);
+      AddOp(OpKind::kSecondStar, 0, false, cur - 2, 4);
       pending = cur += 2;
     } else if (*cur == '4' && cur + 1 != end && *(cur + 1) == 'Y') {
-      // Formats %E4Y.
+      // Compiles %E4Y.
       if (cur - 2 != pending) {
-        FormatTM(&result, std::string(pending, cur - 2), tm);
+        AddText(OpKind::kStrftime, pending, cur - 2 - pending);
       }
-      bp = Format64(ep, 4, bd.year);
-      result.append(bp, ep - bp);
+      AddOp(OpKind::kYear4, 0, false, cur - 2, 4);
       pending = cur += 2;
     } else if (std::isdigit(*cur)) {
       // Possibly found %E#S.
       int n = 0;
-      if (const char* np = ParseInt(cur, 0, 0, 1024, &n)) {
+      if (const char* np = ParseInt(cur, end, 0, 0, 1024, &n)) {
         if (*np++ == 'S') {
-          // Formats %E#S.
+          // Compiles %E#S.
           if (cur - 2 != pending) {
-            FormatTM(&result, std::string(pending, cur - 2), tm);
+            AddText(OpKind::kStrftime, pending, cur - 2 - pending);
           }
-          bp = ep;
+          AddOp(OpKind::kSecondN, n > kDigits10_64 ? kDigits10_64 : n,
+                false, cur - 2, np - (cur - 2));
+          pending = cur = np;
+        }
+      }
+    }
+  }
+
+  // Compiles any remaining data.
+  if (end != pending) {
+    AddText(OpKind::kStrftime, pending, end - pending);
+  }
+}
+
+// Adjacent literals are coalesced into a single op. Any other text is
+// followed by a NUL in text_ so that it may be passed to strftime(3).
+void CompiledFormat::AddText(OpKind kind, const char* text, std::size_t len) {
+  if (len == 0) return;
+  if (kind == OpKind::kLiteral && !ops_.empty() &&
+      ops_.back().kind == OpKind::kLiteral &&
+      ops_.back().pos + ops_.back().len == text_.size()) {
+    ops_.back().len += len;
+  } else {
+    ops_.push_back(Op{kind, 0, false, text_.size(), len});
+  }
+  text_.append(text, len);
+  if (kind != OpKind::kLiteral) text_.push_back('\0');
+}
+
+void CompiledFormat::AddOp(OpKind kind, int arg, bool c_locale,
+                           const char* spec, std::size_t len) {
+  ops_.push_back(Op{kind, arg, c_locale, text_.size(), len});
+  text_.append(spec, len);
+  text_.push_back('\0');
+}
+
+// Where Run() writes the formatted result: either appended to a string, or
+// into a fixed-size buffer, in which case any excess is counted but dropped.
+class CompiledFormat::Sink {
+ public:
+  explicit Sink(std::string* str) : str_(str) {}
+  Sink(char* buf, std::size_t size) : buf_(buf), size_(size) {}
+
+  void Append(const char* p, std::size_t n) {
+    if (str_ != nullptr) {
+      str_->append(p, n);
+    } else if (len_ < size_) {
+      std::memcpy(buf_ + len_, p, std::min(n, size_ - len_));
+    }
+    len_ += n;
+  }
+  void Append(const char* s) { Append(s, std::strlen(s)); }
+
+  std::size_t length() const { return len_; }
+
+ private:
+  std::string* str_ = nullptr;
+  char* buf_ = nullptr;
+  std::size_t size_ = 0;
+  std::size_t len_ = 0;
+};
+
+void CompiledFormat::Run(const time_point& tp, const TimeZone& tz,
+                         Sink* sink) const {
+  const BreakdownLite bd = BreakTimeLite(tp, tz);
+  StrftimeState state(bd);
+
+  // The years for which the std::tm-based conversions of strftime(3) are
+  // known to match ours (i.e., two-digit %y/%C, and four-digit %F).
+  const bool year2 = 0 <= bd.year && bd.year <= 9999;
+  const bool year4 = 1000 <= bd.year && bd.year <= 9999;
+
+  // Scratch buffer for internal conversions.
+  char buf[3 + kDigits10_64];  // enough for longest conversion
+  char* const ep = buf + sizeof(buf);
+  char* bp;  // works back from ep
+  std::vector<char> scratch;  // for strftime(3)
+
+  const char* const text = text_.data();
+  for (const Op& op : ops_) {
+    bool native = !op.c_locale || state.c_locale();
+    if (native) {
+      bp = ep;
+      switch (op.kind) {
+        case OpKind::kLiteral:
+          sink->Append(text + op.pos, op.len);
+          break;
+        case OpKind::kStrftime:
+          native = false;
+          break;
+        case OpKind::kYear:
+          bp = Format64(ep, 0, bd.year);
+          break;
+        case OpKind::kYear4:
+          bp = Format64(ep, 4, bd.year);
+          break;
+        case OpKind::kYear2:
+          native = year2;
+          if (native) bp = Format02d(ep, static_cast<int>(bd.year % 100));
+          break;
+        case OpKind::kCentury:
+          native = year2;
+          if (native) bp = Format02d(ep, static_cast<int>(bd.year / 100));
+          break;
+        case OpKind::kMonth:
+          bp = Format02d(ep, bd.month);
+          break;
+        case OpKind::kDay:
+        case OpKind::kDaySpace:
+          bp = Format02d(ep, bd.day);
+          if (op.kind == OpKind::kDaySpace && *bp == '0') {
+            *bp = ' ';  // for Windows
+          }
+          break;
+        case OpKind::kYearDay:
+          bp = Format64(ep, 3, bd.yearday);
+          break;
+        case OpKind::kWeekdayMon:
+          *--bp = kDigits[bd.weekday];
+          break;
+        case OpKind::kWeekdaySun:
+          *--bp = kDigits[bd.weekday % 7];
+          break;
+        case OpKind::kWeekSun:
+          bp = Format02d(ep, (bd.yearday + 6 - bd.weekday % 7) / 7);
+          break;
+        case OpKind::kWeekMon:
+          bp = Format02d(ep, (bd.yearday + 6 - (bd.weekday - 1)) / 7);
+          break;
+        case OpKind::kHour:
+          bp = Format02d(ep, bd.hour);
+          break;
+        case OpKind::kHour12:
+          bp = Format02d(ep, (bd.hour % 12 == 0) ? 12 : bd.hour % 12);
+          break;
+        case OpKind::kMinute:
+          bp = Format02d(ep, bd.minute);
+          break;
+        case OpKind::kSecond:
+          bp = Format02d(ep, bd.second);
+          break;
+        case OpKind::kSecondN: {
+          const int n = op.arg;
           if (n > 0) {
-            if (n > kDigits10_64) n = kDigits10_64;
             const int64_t nanoseconds = bd.subsecond.count();
             bp = Format64(bp, n, (n > 9) ? nanoseconds * kExp10[n - 9]
                                          : nanoseconds / kExp10[9 - n]);
             *--bp = '.';
           }
           bp = Format02d(bp, bd.second);
-          result.append(bp, ep - bp);
-          pending = cur = np;
+          break;
+        }
+        case OpKind::kSecondStar: {
+          char* cp = ep;
+          const int64_t nanoseconds = bd.subsecond.count();
+          bp = Format64(cp, 9, nanoseconds);
+          while (cp != bp && cp[-1] == '0') --cp;
+          if (cp != bp) *--bp = '.';
+          bp = Format02d(bp, bd.second);
+          sink->Append(bp, cp - bp);
+          bp = ep;
+          break;
         }
+        case OpKind::kDate:
+          native = year4;
+          if (native) {
+            bp = Format02d(ep, bd.day);
+            *--bp = '-';
+            bp = Format02d(bp, bd.month);
+            *--bp = '-';
+            bp = Format64(bp, 0, bd.year);
+          }
+          break;
+        case OpKind::kDateSlash:
+          native = year2;
+          if (native) {
+            bp = Format02d(ep, static_cast<int>(bd.year % 100));
+            *--bp = '/';
+            bp = Format02d(bp, bd.day);
+            *--bp = '/';
+            bp = Format02d(bp, bd.month);
+          }
+          break;
+        case OpKind::kTime:
+        case OpKind::kTime12:
+          if (op.kind == OpKind::kTime12) {
+            *--bp = 'M';
+            *--bp = (bd.hour < 12) ? 'A' : 'P';
+            *--bp = ' ';
+          }
+          bp = Format02d(bp, bd.second);
+          *--bp = ':';
+          bp = Format02d(bp, bd.minute);
+          *--bp = ':';
+          if (op.kind == OpKind::kTime12) {
+            bp = Format02d(bp, (bd.hour % 12 == 0) ? 12 : bd.hour % 12);
+          } else {
+            bp = Format02d(bp, bd.hour);
+          }
+          break;
+        case OpKind::kHourMinute:
+          bp = Format02d(ep, bd.minute);
+          *--bp = ':';
+          bp = Format02d(bp, bd.hour);
+          break;
+        case OpKind::kWeekdayShort:
+          sink->Append(kWeekdayNames[bd.weekday % 7], 3);
+          break;
+        case OpKind::kWeekdayLong:
+          sink->Append(kWeekdayNames[bd.weekday % 7]);
+          break;
+        case OpKind::kMonthShort:
+          sink->Append(kMonthNames[bd.month - 1], 3);
+          break;
+        case OpKind::kMonthLong:
+          sink->Append(kMonthNames[bd.month - 1]);
+          break;
+        case OpKind::kAmPm:
+          sink->Append((bd.hour < 12) ? "AM" : "PM", 2);
+          break;
+        case OpKind::kOffset:
+          bp = FormatOffset(ep, bd.offset / 60, '\0');
+          break;
+        case OpKind::kOffsetColon:
+          bp = FormatOffset(ep, bd.offset / 60, ':');
+          break;
+        case OpKind::kAbbr:
+          sink->Append(bd.abbr);
+          break;
+        case OpKind::kUnixSeconds:
+          bp = Format64(ep, 0, ToUnixSeconds(tp));
+          break;
       }
     }
+    if (native) {
+      sink->Append(bp, ep - bp);
+    } else {
+      CountGlobal(kStrftimeFallbacks);
+      const size_t n = FormatTM(&scratch, text + op.pos, op.len, state.tm());
+      sink->Append(scratch.data(), n);
+    }
   }
+}
 
-  // Formats any remaining data.
-  if (end != pending) {
-    FormatTM(&result, std::string(pending, end), tm);
+std::string Format(const CompiledFormat& format, const time_point& tp,
+                   const TimeZone& tz) {
+  std::string result;
+  CompiledFormat::Sink sink(&result);
+  format.Run(tp, tz, &sink);
+  return result;
+}
+
+void Format(const CompiledFormat& format, const time_point& tp,
+            const TimeZone& tz, std::string* dst) {
+  CompiledFormat::Sink sink(dst);
+  format.Run(tp, tz, &sink);
+}
+
+std::size_t Format(const CompiledFormat& format, const time_point& tp,
+                   const TimeZone& tz, char* buf, std::size_t size) {
+  CompiledFormat::Sink sink(buf, size);
+  format.Run(tp, tz, &sink);
+  return sink.length();
+}
+
+std::string Format(const std::string& format, const time_point& tp,
+                   const TimeZone& tz) {
+  return Format(CompiledFormat(format), tp, tz);
+}
+
+namespace {
+
+// The identities of CachedFormats, which are never reused, and never 0.
+std::atomic<uint64_t> next_cached_format_id(1);
+
+// A whole second as formatted by a CachedFormat in a zone: the text of the
+// segments of the format, each ending where its fraction would go.
+struct CachedSecond {
+  uint64_t id = 0;  // of the format, or 0 if unused
+  uintptr_t zone = 0;
+  int64_t unix_time = 0;
+  std::string text;
+  std::vector<std::size_t> ends;  // of each segment within text
+};
+
+// The seconds cached by each thread, direct mapped by format and zone.
+const std::size_t kCachedSeconds = 8;
+thread_local CachedSecond cached_seconds[kCachedSeconds];
+
+}  // namespace
+
+CachedFormat::CachedFormat(const std::string& format)
+    : format_(format),
+      truncates_(false),
+      id_(next_cached_format_id.fetch_add(1, std::memory_order_relaxed)) {
+  // Split the compiled ops at each fraction. The segments share the text
+  // of the whole format, to which their ops refer.
+  segments_.emplace_back(std::string());
+  for (CompiledFormat::Op op : format_.ops_) {
+    if (op.kind == CompiledFormat::OpKind::kUnixSeconds) truncates_ = true;
+    if (op.kind == CompiledFormat::OpKind::kSecondN ||
+        op.kind == CompiledFormat::OpKind::kSecondStar) {
+      fractions_.push_back(op.kind == CompiledFormat::OpKind::kSecondN
+                               ? op.arg
+                               : -1);
+      op.kind = CompiledFormat::OpKind::kSecond;
+      segments_.back().ops_.push_back(op);
+      segments_.emplace_back(std::string());
+    } else {
+      segments_.back().ops_.push_back(op);
+    }
+  }
+  for (CompiledFormat& segment : segments_) segment.text_ = format_.text_;
+}
+
+void CachedFormat::Run(const time_point& tp, const TimeZone& tz,
+                       CompiledFormat::Sink* sink) const {
+  int64_t unix_time;
+  duration subsecond;
+  SplitUnixTime(tp, &unix_time, &subsecond);
+  if (truncates_ && unix_time < 0 && subsecond != duration::zero()) {
+    // %s would differ from that of the whole second.
+    format_.Run(tp, tz, sink);
+    return;
+  }
+
+  const uintptr_t zone = TimeZone::Impl::DataKey(tz);
+  CachedSecond& cs =
+      cached_seconds[(id_ * 31 + (zone >> 4)) % kCachedSeconds];
+  if (cs.id != id_ || cs.zone != zone || cs.unix_time != unix_time) {
+    cs.id = 0;  // until it is complete
+    cs.text.clear();
+    cs.ends.clear();
+    const time_point second = FromUnixSeconds(unix_time);
+    CompiledFormat::Sink text(&cs.text);
+    for (const CompiledFormat& segment : segments_) {
+      segment.Run(second, tz, &text);
+      cs.ends.push_back(cs.text.size());
+    }
+    cs.id = id_;
+    cs.zone = zone;
+    cs.unix_time = unix_time;
+  }
+
+  const int64_t nanoseconds = subsecond.count();
+  char buf[1 + kDigits10_64];
+  char* const ep = buf + sizeof(buf);
+  std::size_t pos = 0;
+  for (std::size_t i = 0; i != cs.ends.size(); ++i) {
+    sink->Append(cs.text.data() + pos, cs.ends[i] - pos);
+    pos = cs.ends[i];
+    if (i == fractions_.size()) break;
+    const int n = fractions_[i];
+    if (n > 0) {
+      char* bp = Format64(ep, n, (n > 9) ? nanoseconds * kExp10[n - 9]
+                                         : nanoseconds / kExp10[9 - n]);
+      *--bp = '.';
+      sink->Append(bp, ep - bp);
+    } else if (n < 0) {
+      char* cp = ep;
+      char* bp = Format64(cp, 9, nanoseconds);
+      while (cp != bp && cp[-1] == '0') --cp;
+      if (cp != bp) {
+        *--bp = '.';
+        sink->Append(bp, cp - bp);
+      }
+    }
   }
+}
+
+void CachedFormat::Run(const time_point& tp, const TimeZone& tz,
+                       std::string* dst) const {
+  CompiledFormat::Sink sink(dst);
+  Run(tp, tz, &sink);
+}
 
+std::size_t CachedFormat::Run(const time_point& tp, const TimeZone& tz,
+                              char* buf, std::size_t size) const {
+  CompiledFormat::Sink sink(buf, size);
+  Run(tp, tz, &sink);
+  return sink.length();
+}
+
+std::string Format(const CachedFormat& format, const time_point& tp,
+                   const TimeZone& tz) {
+  std::string result;
+  format.Run(tp, tz, &result);
   return result;
 }
 
+void Format(const CachedFormat& format, const time_point& tp,
+            const TimeZone& tz, std::string* dst) {
+  format.Run(tp, tz, dst);
+}
+
+std::size_t Format(const CachedFormat& format, const time_point& tp,
+                   const TimeZone& tz, char* buf, std::size_t size) {
+  return format.Run(tp, tz, buf, size);
+}
+
 namespace {
 
-const char* ParseOffset(const char* dp, char sep, int* offset) {
+// The parsing helpers below take input that ends at ep, which need not be
+// NUL terminated, and return nullptr on failure (or when passed nullptr).
+
+const char* ParseOffset(const char* dp, const char* ep, char sep,
+                        int* offset) {
   if (dp != nullptr) {
-    const char sign = *dp++;
+    const char sign = (dp != ep) ? *dp++ : '\0';
     if (sign == '+' || sign == '-') {
       int hours = 0;
-      const char* ap = ParseInt(dp, 2, 0, 23, &hours);
+      const char* ap = ParseInt(dp, ep, 2, 0, 23, &hours);
       if (ap != nullptr && ap - dp == 2) {
         dp = ap;
-        if (sep != '\0' && *ap == sep) ++ap;
+        if (sep != '\0' && ap != ep && *ap == sep) ++ap;
         int minutes = 0;
-        const char* bp = ParseInt(ap, 2, 0, 59, &minutes);
+        const char* bp = ParseInt(ap, ep, 2, 0, 59, &minutes);
         if (bp != nullptr && bp - ap == 2) dp = bp;
         *offset = (hours * 60 + minutes) * 60;
         if (sign == '-') *offset = -*offset;
@@ -411,24 +834,27 @@ const char* ParseOffset(const char* dp, char sep, int* offset) {
   return dp;
 }
 
-const char* ParseZone(const char* dp, std::string* zone) {
+const char* ParseZone(const char* dp, const char* ep, std::string* zone) {
   zone->clear();
   if (dp != nullptr) {
-    while (*dp != '\0' && !std::isspace(*dp)) zone->push_back(*dp++);
+    while (dp != ep && *dp != '\0' && !std::isspace(*dp)) {
+      zone->push_back(*dp++);
+    }
     if (zone->empty()) dp = nullptr;
   }
   return dp;
 }
 
-const char* ParseSubSeconds(const char* dp, duration* subseconds) {
+const char* ParseSubSeconds(const char* dp, const char* ep,
+                            duration* subseconds) {
   if (dp != nullptr) {
-    if (*dp == '.') {
+    if (dp != ep && *dp == '.') {
       int64_t v = 0;
       int64_t exp = 0;
       const char* const bp = ++dp;
-      while (const char* cp = strchr(kDigits, *dp)) {
-        int d = static_cast<int>(cp - kDigits);
-        if (d >= 10) break;
+      while (dp != ep) {
+        const int d = static_cast<unsigned char>(*dp) - '0';
+        if (d < 0 || d >= 10) break;
         if (exp < 9) {
           exp += 1;
           v *= 10;
@@ -447,7 +873,8 @@ const char* ParseSubSeconds(const char* dp, duration* subseconds) {
   return dp;
 }
 
-// Parses a string into a std::tm using strptime(3).
+// Parses a string into a std::tm using strptime(3). Unlike the helpers
+// above, this requires NUL-terminated input.
 const char* ParseTM(const char* dp, const char* fmt, std::tm* tm) {
   if (dp != nullptr) {
     dp = strptime(dp, fmt, tm);
@@ -455,6 +882,77 @@ const char* ParseTM(const char* dp, const char* fmt, std::tm* tm) {
   return dp;
 }
 
+const char* SkipSpace(const char* dp, const char* ep) {
+  while (dp != ep && std::isspace(*dp)) ++dp;
+  return dp;
+}
+
+// The RFC3339 layouts that Parse() recognizes for its fast path.
+const char kRFC3339Full[] = "%Y-%m-%dT%H:%M:%E*S%Ez";
+const char kRFC3339Sec[] = "%Y-%m-%dT%H:%M:%S%Ez";
+
+// Parses the two decimal digits at dp, returning false if either is not.
+inline bool Parse2d(const char* dp, int* vp) {
+  const unsigned d1 = static_cast<unsigned char>(dp[0]) - '0';
+  const unsigned d0 = static_cast<unsigned char>(dp[1]) - '0';
+  *vp = static_cast<int>(d1 * 10 + d0);
+  return d1 < 10 && d0 < 10;
+}
+
+// Parses an input that begins with the canonical RFC3339 layout, that is
+// "YYYY-MM-DDTHH:MM:SS[.s+](Z|+HH:MM|-HH:MM)", with the fractional part
+// only present when allowed, and with no leap second. Fields are validated
+// and converted with fixed-offset arithmetic, so the result is independent
+// of any time zone. Returns the end of the parsed input, or nullptr when
+// the input is anything else, including invalid, in which case the general
+// parser should decide.
+const char* ParseRFC3339Canonical(const char* dp, const char* ep,
+                                  bool fractional, time_point* tpp) {
+  if (ep - dp < 20) return nullptr;  // "YYYY-MM-DDTHH:MM:SSZ"
+  int yh, yl, mon, day, hour, min, sec;
+  if (!Parse2d(dp + 0, &yh) || !Parse2d(dp + 2, &yl) || dp[4] != '-' ||
+      !Parse2d(dp + 5, &mon) || dp[7] != '-' || !Parse2d(dp + 8, &day) ||
+      dp[10] != 'T' || !Parse2d(dp + 11, &hour) || dp[13] != ':' ||
+      !Parse2d(dp + 14, &min) || dp[16] != ':' || !Parse2d(dp + 17, &sec)) {
+    return nullptr;
+  }
+  const int year = yh * 100 + yl;
+  if (mon < 1 || mon > 12 || day < 1 || hour > 23 || min > 59 || sec > 59) {
+    return nullptr;
+  }
+  if (day > kDaysPerMonth[IsLeap(year)][mon]) return nullptr;
+  dp += 19;
+
+  duration subseconds = duration::zero();
+  if (*dp == '.') {
+    if (!fractional) return nullptr;
+    dp = ParseSubSeconds(dp, ep, &subseconds);
+    if (dp == nullptr || dp == ep) return nullptr;
+  }
+
+  int offset = 0;
+  if (*dp == 'Z') {
+    dp += 1;
+  } else if (*dp == '+' || *dp == '-') {
+    if (ep - dp < 6) return nullptr;
+    int off_hour, off_min;
+    if (!Parse2d(dp + 1, &off_hour) || dp[3] != ':' ||
+        !Parse2d(dp + 4, &off_min) || off_hour > 23 || off_min > 59) {
+      return nullptr;
+    }
+    offset = (off_hour * 60 + off_min) * 60;
+    if (*dp == '-') offset = -offset;
+    dp += 6;
+  } else {
+    return nullptr;
+  }
+
+  const int64_t unix_time = DayOrdinal<int64_t>(year, mon, day) * 86400 +
+                            ((hour * 60 + min) * 60 + sec) - offset;
+  *tpp = time_point(std::chrono::duration<int64_t>(unix_time)) + subseconds;
+  return dp;
+}
+
 }  // namespace
 
 // Uses strptime(3) to parse the given input.  Supports the same extended
@@ -470,176 +968,277 @@ const char* ParseTM(const char* dp, const char* fmt, std::tm* tm) {
 //
 // We also handle the %z specifier to accommodate platforms that do not
 // support the tm_gmtoff extension to std::tm.  %Z is parsed but ignored.
-bool Parse(const std::string& format, const std::string& input,
-           const TimeZone& tz, time_point* tpp) {
-  // The unparsed input.
-  const char* data = input.c_str();  // NUL terminated
-
-  // Skips leading whitespace.
-  while (std::isspace(*data)) ++data;
-
-  const int kintmax = std::numeric_limits<int>::max();
-  const int kintmin = std::numeric_limits<int>::min();
-
-  // Sets default values for unspecified fields.
-  std::tm tm = {0};
-  tm.tm_year = 1970 - 1900;
-  tm.tm_mon = 1 - 1;  // Jan
-  tm.tm_mday = 1;
-  tm.tm_hour = 0;
-  tm.tm_min = 0;
-  tm.tm_sec = 0;
-  tm.tm_wday = 4;  // Thu
-  tm.tm_yday = 0;
-  tm.tm_isdst = 0;
-  duration subseconds = duration::zero();
-  int offset = kintmin;
-  std::string zone = "UTC";
+CompiledParser::CompiledParser(const std::string& format) {
+  if (format == kRFC3339Full) rfc3339_ = RFC3339::kFull;
+  if (format == kRFC3339Sec) rfc3339_ = RFC3339::kSec;
 
   const char* fmt = format.c_str();  // NUL terminated
-  bool twelve_hour = false;
-  bool afternoon = false;
-
-  bool saw_precent_s = false;
-  int64_t percent_s_time = 0;
+  const char* const end = fmt + std::strlen(fmt);
 
   // Steps through format, one specifier at a time.
-  while (data != nullptr && *fmt != '\0') {
+  while (*fmt != '\0') {
     if (std::isspace(*fmt)) {
-      while (std::isspace(*data)) ++data;
       while (std::isspace(*++fmt)) continue;
+      AddOp(OpKind::kSpace, -1, nullptr, 0);
       continue;
     }
 
     if (*fmt != '%') {
-      if (*data == *fmt) {
-        ++data;
-        ++fmt;
-      } else {
-        data = nullptr;
-      }
+      const char* literal = fmt;
+      while (*fmt != '\0' && *fmt != '%' && !std::isspace(*fmt)) ++fmt;
+      AddOp(OpKind::kLiteral, -1, literal, fmt - literal);
       continue;
     }
 
     const char* percent = fmt;
     if (*++fmt == '\0') {
-      data = nullptr;
+      AddOp(OpKind::kFail, -1, nullptr, 0);
       continue;
     }
+    int twelve_hour = -1;  // unchanged
     switch (*fmt++) {
       case 'Y':
-        // We're more liberal than the 4-digit year typically handled by
-        // strptime(), but we still need to store the result in an int,
-        // and the intermediate value has a 1900 excess.
-        data = ParseInt(data, 0, kintmin + 1900, kintmax, &tm.tm_year);
-        if (data != nullptr) tm.tm_year -= 1900;
+        AddOp(OpKind::kYear, -1, nullptr, 0);
         continue;
       case 'm':
-        data = ParseInt(data, 2, 1, 12, &tm.tm_mon);
-        if (data != nullptr) tm.tm_mon -= 1;
+        AddOp(OpKind::kMonth, -1, nullptr, 0);
         continue;
       case 'd':
-        data = ParseInt(data, 2, 1, 31, &tm.tm_mday);
+        AddOp(OpKind::kDay, -1, nullptr, 0);
         continue;
       case 'H':
-        data = ParseInt(data, 2, 0, 23, &tm.tm_hour);
-        twelve_hour = false;
+        AddOp(OpKind::kHour, 0, nullptr, 0);
         continue;
       case 'M':
-        data = ParseInt(data, 2, 0, 59, &tm.tm_min);
+        AddOp(OpKind::kMinute, -1, nullptr, 0);
         continue;
       case 'S':
-        data = ParseInt(data, 2, 0, 60, &tm.tm_sec);
+        AddOp(OpKind::kSecond, -1, nullptr, 0);
         continue;
       case 'I':
       case 'r':  // probably uses %I
-        twelve_hour = true;
+        twelve_hour = 1;
         break;
       case 'R':  // uses %H
       case 'T':  // uses %H
       case 'c':  // probably uses %H
       case 'X':  // probably uses %H
-        twelve_hour = false;
+        twelve_hour = 0;
         break;
       case 'z':
-        data = ParseOffset(data, '\0', &offset);
+        AddOp(OpKind::kOffset, -1, nullptr, 0);
         continue;
       case 'Z':  // ignored; zone abbreviations are ambiguous
-        data = ParseZone(data, &zone);
+        AddOp(OpKind::kZone, -1, nullptr, 0);
         continue;
       case 's':
-        data = ParseInt(data, 0, INT64_MIN, INT64_MAX, &percent_s_time);
-        if (data != nullptr) saw_precent_s = true;
+        AddOp(OpKind::kUnixSeconds, -1, nullptr, 0);
         continue;
       case 'E':
         if (*fmt == 'z') {
-          if (data != nullptr && *data == 'Z') {  // Zulu
-            offset = 0;
-            data += 1;
-          } else {
-            data = ParseOffset(data, ':', &offset);
-          }
+          AddOp(OpKind::kOffsetColon, -1, nullptr, 0);
           fmt += 1;
           continue;
         }
         if (*fmt == '*' && *(fmt + 1) == 'S') {
-          data = ParseInt(data, 2, 0, 60, &tm.tm_sec);
-          data = ParseSubSeconds(data, &subseconds);
+          AddOp(OpKind::kSecondFraction, -1, nullptr, 0);
           fmt += 2;
           continue;
         }
         if (*fmt == '4' && *(fmt + 1) == 'Y') {
-          const char* bp = data;
-          data = ParseInt(data, 4, -999, 9999, &tm.tm_year);
-          if (data != nullptr) {
-            if (data - bp == 4) {
-              tm.tm_year -= 1900;
-            } else {
-              data = nullptr;  // stopped too soon
-            }
-          }
+          AddOp(OpKind::kYear4, -1, nullptr, 0);
           fmt += 2;
           continue;
         }
         if (std::isdigit(*fmt)) {
           int n = 0;
-          if (const char* np = ParseInt(fmt, 0, 0, 1024, &n)) {
+          if (const char* np = ParseInt(fmt, end, 0, 0, 1024, &n)) {
             if (*np++ == 'S') {
-              data = ParseInt(data, 2, 0, 60, &tm.tm_sec);
-              if (n > 0) {  // n is otherwise ignored
-                data = ParseSubSeconds(data, &subseconds);
-              }
+              // n is otherwise ignored
+              AddOp(n > 0 ? OpKind::kSecondFraction : OpKind::kSecond, -1,
+                    nullptr, 0);
               fmt = np;
               continue;
             }
           }
         }
-        if (*fmt == 'c') twelve_hour = false;  // probably uses %H
-        if (*fmt == 'X') twelve_hour = false;  // probably uses %H
+        if (*fmt == 'c') twelve_hour = 0;  // probably uses %H
+        if (*fmt == 'X') twelve_hour = 0;  // probably uses %H
         if (*fmt != '\0') ++fmt;
         break;
       case 'O':
-        if (*fmt == 'H') twelve_hour = false;
-        if (*fmt == 'I') twelve_hour = true;
+        if (*fmt == 'H') twelve_hour = 0;
+        if (*fmt == 'I') twelve_hour = 1;
         if (*fmt != '\0') ++fmt;
         break;
     }
 
-    // Parses the current specifier.
-    const char* orig_data = data;
-    std::string spec(percent, fmt - percent);
-    data = ParseTM(data, spec.c_str(), &tm);
-
-    // If we successfully parsed %p we need to remember whether the result
-    // was AM or PM so that we can adjust tm_hour before ConvertDateTime().
-    // So reparse the input with a known AM hour, and check if it is shifted
-    // to a PM hour.
-    if (spec == "%p" && data != nullptr) {
-      std::string test_input = "1" + std::string(orig_data, data - orig_data);
-      const char* test_data = test_input.c_str();
-      std::tm tmp = {0};
-      ParseTM(test_data, "%I%p", &tmp);
-      afternoon = (tmp.tm_hour == 13);
+    // Parses the current specifier with strptime(3).
+    AddOp(OpKind::kStrptime, twelve_hour, percent, fmt - percent);
+  }
+}
+
+void CompiledParser::AddOp(OpKind kind, int twelve_hour,
+                           const char* text, std::size_t len) {
+  const bool am_pm = (kind == OpKind::kStrptime) &&
+                     (len == 2 && text[0] == '%' && text[1] == 'p');
+  ops_.push_back(Op{kind, static_cast<int8_t>(twelve_hour), am_pm,
+                    text_.size(), len});
+  text_.append(text, len);
+  text_.push_back('\0');
+}
+
+bool CompiledParser::Run(const char* input, std::size_t len,
+                         const TimeZone& tz, time_point* tpp,
+                         std::size_t* consumed) const {
+  // The unparsed input is [data ... end).
+  const char* begin = input;
+  const char* end = input + len;
+  const char* data = SkipSpace(begin, end);
+
+  // Takes the fast path for well-formed input in the common RFC3339 layouts,
+  // which with an explicit UTC offset does not depend on tz at all.
+  if (rfc3339_ != RFC3339::kNone) {
+    const bool fractional = (rfc3339_ == RFC3339::kFull);
+    time_point tp;
+    if (const char* dp = ParseRFC3339Canonical(data, end, fractional, &tp)) {
+      if (consumed != nullptr || dp == end) {
+        if (consumed != nullptr) *consumed = dp - begin;
+        *tpp = tp;
+        return true;
+      }
+    }
+  }
+
+  // A NUL-terminated copy of the input, made should strptime(3) be needed.
+  std::string copy;
+
+  const int kintmax = std::numeric_limits<int>::max();
+  const int kintmin = std::numeric_limits<int>::min();
+
+  // Sets default values for unspecified fields.
+  std::tm tm = {0};
+  tm.tm_year = 1970 - 1900;
+  tm.tm_mon = 1 - 1;  // Jan
+  tm.tm_mday = 1;
+  tm.tm_hour = 0;
+  tm.tm_min = 0;
+  tm.tm_sec = 0;
+  tm.tm_wday = 4;  // Thu
+  tm.tm_yday = 0;
+  tm.tm_isdst = 0;
+  duration subseconds = duration::zero();
+  int offset = kintmin;
+  std::string zone = "UTC";
+
+  bool twelve_hour = false;
+  bool afternoon = false;
+
+  bool saw_precent_s = false;
+  int64_t percent_s_time = 0;
+
+  const char* const text = text_.data();
+  for (const Op& op : ops_) {
+    if (data == nullptr) break;
+    if (op.twelve_hour >= 0) twelve_hour = (op.twelve_hour != 0);
+    switch (op.kind) {
+      case OpKind::kSpace:
+        data = SkipSpace(data, end);
+        break;
+      case OpKind::kLiteral:
+        if (static_cast<std::size_t>(end - data) >= op.len &&
+            std::memcmp(data, text + op.pos, op.len) == 0) {
+          data += op.len;
+        } else {
+          data = nullptr;
+        }
+        break;
+      case OpKind::kFail:
+        data = nullptr;
+        break;
+      case OpKind::kYear:
+        // We're more liberal than the 4-digit year typically handled by
+        // strptime(), but we still need to store the result in an int,
+        // and the intermediate value has a 1900 excess.
+        data = ParseInt(data, end, 0, kintmin + 1900, kintmax, &tm.tm_year);
+        if (data != nullptr) tm.tm_year -= 1900;
+        break;
+      case OpKind::kYear4: {
+        const char* bp = data;
+        data = ParseInt(data, end, 4, -999, 9999, &tm.tm_year);
+        if (data != nullptr) {
+          if (data - bp == 4) {
+            tm.tm_year -= 1900;
+          } else {
+            data = nullptr;  // stopped too soon
+          }
+        }
+        break;
+      }
+      case OpKind::kMonth:
+        data = ParseInt(data, end, 2, 1, 12, &tm.tm_mon);
+        if (data != nullptr) tm.tm_mon -= 1;
+        break;
+      case OpKind::kDay:
+        data = ParseInt(data, end, 2, 1, 31, &tm.tm_mday);
+        break;
+      case OpKind::kHour:
+        data = ParseInt(data, end, 2, 0, 23, &tm.tm_hour);
+        break;
+      case OpKind::kMinute:
+        data = ParseInt(data, end, 2, 0, 59, &tm.tm_min);
+        break;
+      case OpKind::kSecond:
+        data = ParseInt(data, end, 2, 0, 60, &tm.tm_sec);
+        break;
+      case OpKind::kSecondFraction:
+        data = ParseInt(data, end, 2, 0, 60, &tm.tm_sec);
+        data = ParseSubSeconds(data, end, &subseconds);
+        break;
+      case OpKind::kOffset:
+        data = ParseOffset(data, end, '\0', &offset);
+        break;
+      case OpKind::kOffsetColon:
+        if (data != end && *data == 'Z') {  // Zulu
+          offset = 0;
+          data += 1;
+        } else {
+          data = ParseOffset(data, end, ':', &offset);
+        }
+        break;
+      case OpKind::kZone:
+        data = ParseZone(data, end, &zone);
+        break;
+      case OpKind::kUnixSeconds:
+        data = ParseInt(data, end, 0, INT64_MIN, INT64_MAX, &percent_s_time);
+        if (data != nullptr) saw_precent_s = true;
+        break;
+      case OpKind::kStrptime: {
+        CountGlobal(kStrptimeFallbacks);
+        if (copy.data() != begin) {
+          // Switches over to a NUL-terminated copy of the input.
+          copy.assign(begin, end);
+          data = copy.data() + (data - begin);
+          begin = copy.data();
+          end = begin + copy.size();
+        }
+        const char* orig_data = data;
+        data = ParseTM(data, text + op.pos, &tm);
+
+        // If we successfully parsed %p we need to remember whether the
+        // result was AM or PM so that we can adjust tm_hour before
+        // ConvertDateTime(). So reparse the input with a known AM hour,
+        // and check if it is shifted to a PM hour.
+        if (op.am_pm && data != nullptr) {
+          std::string test_input =
+              "1" + std::string(orig_data, data - orig_data);
+          const char* test_data = test_input.c_str();
+          std::tm tmp = {0};
+          ParseTM(test_data, "%I%p", &tmp);
+          afternoon = (tmp.tm_hour == 13);
+        }
+        break;
+      }
     }
   }
 
@@ -650,32 +1249,27 @@ bool Parse(const std::string& format, const std::string& input,
 
   if (data == nullptr) return false;
 
-  // Skip any remaining whitespace.
-  while (std::isspace(*data)) ++data;
+  const char* const stop = data;
+  if (consumed == nullptr) {
+    // Skip any remaining whitespace.
+    data = SkipSpace(data, end);
 
-  // Parse() must consume the entire input string.
-  if (*data != '\0') return false;
+    // Parse() must consume the entire input string.
+    if (data != end) return false;
+  }
 
   // If we saw %s then we ignore anything else and return that time.
   if (saw_precent_s) {
     *tpp = time_point(std::chrono::duration<int64_t>(percent_s_time));
+    if (consumed != nullptr) *consumed = stop - begin;
     return true;
   }
 
-  // If we saw %z or %Ez then we want to interpret the parsed fields in
-  // UTC and then shift by that offset.  Otherwise we want to interpret
-  // the fields directly in the passed TimeZone.
-  TimeZone ptz = tz;
-  if (offset != kintmin) {
-    ptz = UTCTimeZone();  // Override tz.  Offset applied later.
-  } else {
-    offset = 0;  // No offset from passed tz.
-  }
-
   // Allows a leap second of 60 to normalize forward to the following ":00".
+  int leap_second = 0;
   if (tm.tm_sec == 60) {
     tm.tm_sec -= 1;
-    offset -= 1;
+    leap_second = 1;
     subseconds = duration::zero();
   }
 
@@ -685,15 +1279,65 @@ bool Parse(const std::string& format, const std::string& input,
   } else {
     year += 1900;
   }
-  const TimeInfo ti = MakeTimeInfo(year, tm.tm_mon + 1, tm.tm_mday,
-                                   tm.tm_hour, tm.tm_min, tm.tm_sec, ptz);
+
+  // If we saw %z or %Ez then we interpret the parsed fields at that fixed
+  // offset, which needs no TimeZone.  Otherwise we want to interpret the
+  // fields directly in the passed TimeZone.
+  const TimeInfo ti =
+      (offset != kintmin)
+          ? FixedOffsetTimeInfo(year, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour,
+                                tm.tm_min, tm.tm_sec, offset)
+          : MakeTimeInfo(year, tm.tm_mon + 1, tm.tm_mday,
+                         tm.tm_hour, tm.tm_min, tm.tm_sec, tz);
 
   // Parse() fails if any normalization was done.  That is,
   // parsing "Sep 31" will not produce the equivalent of "Oct 1".
   if (ti.normalized) return false;
 
-  *tpp = ti.pre - std::chrono::seconds(offset) + subseconds;
+  *tpp = ti.pre + std::chrono::seconds(leap_second) + subseconds;
+  if (consumed != nullptr) *consumed = stop - begin;
   return true;
 }
 
+bool Parse(const CompiledParser& format, const char* input, std::size_t len,
+           const TimeZone& tz, time_point* tpp) {
+  return format.Run(input, len, tz, tpp, nullptr);
+}
+
+bool Parse(const CompiledParser& format, const char* input, std::size_t len,
+           const TimeZone& tz, time_point* tpp, std::size_t* consumed) {
+  return format.Run(input, len, tz, tpp, consumed);
+}
+
+namespace {
+
+// The formats most recently compiled for Parse() on this thread, so that a
+// format parsed repeatedly (as in a loop) is only compiled, and allocates,
+// once.
+struct CachedParser {
+  std::string format;
+  std::unique_ptr<CompiledParser> parser;
+};
+const std::size_t kCachedParsers = 4;
+thread_local CachedParser cached_parsers[kCachedParsers];
+thread_local std::size_t next_cached_parser = 0;
+
+// Returns the compiled parser for format, compiling it if it is not cached.
+const CompiledParser& ParserFor(const std::string& format) {
+  for (const CachedParser& cp : cached_parsers) {
+    if (cp.parser != nullptr && cp.format == format) return *cp.parser;
+  }
+  CachedParser& cp = cached_parsers[next_cached_parser++ % kCachedParsers];
+  cp.parser.reset(new CompiledParser(format));
+  cp.format = format;
+  return *cp.parser;
+}
+
+}  // namespace
+
+bool Parse(const std::string& format, const std::string& input,
+           const TimeZone& tz, time_point* tpp) {
+  return Parse(ParserFor(format), input.data(), input.size(), tz, tpp);
+}
+
 }  // namespace cctz
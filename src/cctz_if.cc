@@ -14,6 +14,7 @@
 //     limitations under the License.
 
 #include "src/cctz_if.h"
+#include "src/cctz_fixed.h"
 #include "src/cctz_info.h"
 #include "src/cctz_libc.h"
 
@@ -21,15 +22,81 @@ namespace cctz {
 
 std::unique_ptr<TimeZoneIf> TimeZoneIf::Load(const std::string& name) {
   // Support "libc:localtime" and "libc:*" to access the legacy
-  // localtime and UTC support respectively from the C library.
+  // localtime and UTC support respectively from the C library, and
+  // "libc:snapshot" for the C library's local zone without calling it.
+  if (name == "libc:snapshot") return TimeZoneLibC::LoadSnapshot();
   if (name.compare(0, 5, "libc:") == 0) {
     return std::unique_ptr<TimeZoneIf>(new TimeZoneLibC(name.substr(5)));
   }
 
+  // Fixed offsets need no data at all.
+  int32_t offset;
+  std::string abbr;
+  if (ParseFixedOffset(name, &offset, &abbr)) {
+    return std::unique_ptr<TimeZoneIf>(new TimeZoneFixed(offset, abbr));
+  }
+
   // Otherwise use the "zoneinfo" implementation by default.
   std::unique_ptr<TimeZoneInfo> tz(new TimeZoneInfo);
   if (!tz->Load(name)) tz.reset();
   return std::unique_ptr<TimeZoneIf>(tz.release());
 }
 
+void TimeZoneIf::BreakTimes(const int64_t* unix_seconds, std::size_t n,
+                            const BreakdownColumns& out) const {
+  for (std::size_t i = 0; i != n; ++i) {
+    StoreBreakdown(BreakTime(unix_seconds[i]), i, out);
+  }
+}
+
+void TimeZoneIf::MakeTimes(const CivilColumns& civil, std::size_t n,
+                           int64_t* unix_seconds,
+                           TimeInfo::Kind* kinds) const {
+  for (std::size_t i = 0; i != n; ++i) {
+    MakeTimeRow(*this, civil, i, unix_seconds, kinds);
+  }
+}
+
+int64_t TimeZoneIf::StartOfSpan(int64_t unix_time, int64_t span) const {
+  const BreakdownLite bd = BreakTime(unix_time);
+  const int hour = (span == kSecsPerDay) ? 0 : bd.hour;
+  const TimeInfo ti = MakeTimeInfo(bd.year, bd.month, bd.day, hour, 0, 0);
+  return ToUnixSeconds(ti.kind == TimeInfo::Kind::SKIPPED ? ti.trans : ti.pre);
+}
+
+bool TimeZoneIf::NextTransition(int64_t, int64_t*) const {
+  return false;
+}
+
+bool TimeZoneIf::PrevTransition(int64_t, int64_t*) const {
+  return false;
+}
+
+void MakeTimeRow(const TimeZoneIf& tz, const CivilColumns& civil,
+                 std::size_t i, int64_t* unix_seconds, TimeInfo::Kind* kinds) {
+  const int hour = (civil.hour != nullptr) ? civil.hour[i] : 0;
+  const int min = (civil.minute != nullptr) ? civil.minute[i] : 0;
+  const int sec = (civil.second != nullptr) ? civil.second[i] : 0;
+  const TimeInfo ti = tz.MakeTimeInfo(civil.year[i], civil.month[i],
+                                      civil.day[i], hour, min, sec);
+  unix_seconds[i] = ToUnixSeconds(ti.pre);
+  if (kinds != nullptr) kinds[i] = ti.kind;
+}
+
+void StoreBreakdown(const BreakdownLite& bd, std::size_t i,
+                    const BreakdownColumns& out) {
+  if (out.year != nullptr) out.year[i] = bd.year;
+  if (out.month != nullptr) out.month[i] = bd.month;
+  if (out.day != nullptr) out.day[i] = bd.day;
+  if (out.hour != nullptr) out.hour[i] = bd.hour;
+  if (out.minute != nullptr) out.minute[i] = bd.minute;
+  if (out.second != nullptr) out.second[i] = bd.second;
+  if (out.subsecond != nullptr) out.subsecond[i] = bd.subsecond;
+  if (out.weekday != nullptr) out.weekday[i] = bd.weekday;
+  if (out.yearday != nullptr) out.yearday[i] = bd.yearday;
+  if (out.offset != nullptr) out.offset[i] = bd.offset;
+  if (out.is_dst != nullptr) out.is_dst[i] = bd.is_dst;
+  if (out.abbr != nullptr) out.abbr[i] = bd.abbr;
+}
+
 }  // namespace cctz
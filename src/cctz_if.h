@@ -16,10 +16,15 @@
 #ifndef CCTZ_IF_H_
 #define CCTZ_IF_H_
 
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
 #include <memory>
 #include <string>
 
 #include "src/cctz.h"
+#include "src/cctz_counters.h"
 
 namespace cctz {
 
@@ -27,21 +32,92 @@ namespace cctz {
 // Subclasses implement the functions for civil-time conversions in the zone.
 class TimeZoneIf {
  public:
+  // The implementations that TimeZone::Impl calls directly, rather than
+  // through the virtual functions below.
+  enum class Kind { kOther, kInfo, kFixed };
+
   // A factory function for TimeZoneIf implementations.
   static std::unique_ptr<TimeZoneIf> Load(const std::string& name);
 
   virtual ~TimeZoneIf() {}
 
-  virtual Breakdown BreakTime(const time_point& tp) const = 0;
+  // Breaks seconds since the Unix epoch down to civil time (with a zero
+  // subsecond), leaving any subsecond to the caller.
+  virtual BreakdownLite BreakTime(int64_t unix_time) const = 0;
+  // Converts n times in seconds since the Unix epoch into the columns at
+  // index [0, n). The default simply calls BreakTime() for each time.
+  virtual void BreakTimes(const int64_t* unix_seconds, std::size_t n,
+                          const BreakdownColumns& out) const;
   virtual TimeInfo MakeTimeInfo(int64_t year, int mon, int day,
                                 int hour, int min, int sec) const = 0;
+  // Converts rows [0, n) of the civil columns into seconds since the Unix
+  // epoch, and their kinds when non-null. The default simply calls
+  // MakeTimeInfo() for each row.
+  virtual void MakeTimes(const CivilColumns& civil, std::size_t n,
+                         int64_t* unix_seconds, TimeInfo::Kind* kinds) const;
+  // Returns the first second of the civil span (a day or an hour, as span
+  // is kSecsPerDay or kSecsPerHour) that contains unix_time. The default
+  // breaks unix_time down and converts the start of its span back, taking
+  // its first occurrence, or the transition where it begins if skipped.
+  virtual int64_t StartOfSpan(int64_t unix_time, int64_t span) const;
+  // Finds the first transition after unix_time (or the last one before
+  // it), that is, a change of UTC offset, DST flag or abbreviation, and
+  // stores its time in *trans. Returns false if there is none, which is
+  // the default.
+  virtual bool NextTransition(int64_t unix_time, int64_t* trans) const;
+  virtual bool PrevTransition(int64_t unix_time, int64_t* trans) const;
+
+  Kind kind() const { return kind_; }
+
+  // Adds n to one of the zone's counters (see cctz_stats.h), if it has
+  // them. Does nothing unless built with CCTZ_STATS.
+#ifdef CCTZ_STATS
+  void Count(ZoneCounter counter, uint64_t n = 1) const {
+    if (counters_ != nullptr) counters_->Add(counter, n);
+  }
+#else
+  void Count(ZoneCounter, uint64_t = 1) const {}
+#endif
+  void set_counters(ZoneCounters* counters) { counters_ = counters; }
 
  protected:
-  TimeZoneIf() {}
+  constexpr explicit TimeZoneIf(Kind kind = Kind::kOther)
+      : kind_(kind), counters_(nullptr) {}
+
+ private:
+  const Kind kind_;
+  ZoneCounters* counters_;  // owned by the TimeZone::Impl, or null
 };
 
+// Stores bd as element i of the non-null columns in out.
+void StoreBreakdown(const BreakdownLite& bd, std::size_t i,
+                    const BreakdownColumns& out);
+
+// Converts row i of the civil columns as if by MakeTimeInfo(), storing the
+// pre-transition time and kind in element i of the (non-null) outputs.
+void MakeTimeRow(const TimeZoneIf& tz, const CivilColumns& civil,
+                 std::size_t i, int64_t* unix_seconds, TimeInfo::Kind* kinds);
+
+const int64_t kNanosPerSecond = 1000 * 1000 * 1000;
+const int64_t kSecsPerHour = 60 * 60;
+const int64_t kSecsPerDay = 24 * kSecsPerHour;
+
+// Returns the count of nanoseconds since the Unix epoch in tp.
+inline __int128 UnixNanos(const time_point& tp) {
+  return (tp - std::chrono::system_clock::from_time_t(0)).count();
+}
+
+// Returns whether the nanoseconds fit in 64 bits, and so can be divided
+// without a call to the 128-bit runtime routines.
+inline bool FitsInt64(__int128 nanos) {
+  return nanos >= std::numeric_limits<int64_t>::min() &&
+         nanos <= std::numeric_limits<int64_t>::max();
+}
+
 // Convert a time_point to a count of seconds since the Unix epoch.
 inline int64_t ToUnixSeconds(const time_point& tp) {
+  const __int128 nanos = UnixNanos(tp);
+  if (FitsInt64(nanos)) return static_cast<int64_t>(nanos) / kNanosPerSecond;
   return std::chrono::duration_cast<std::chrono::duration<int64_t>>(
              tp - std::chrono::system_clock::from_time_t(0))
       .count();
@@ -54,6 +130,38 @@ inline time_point FromUnixSeconds(int64_t t) {
          std::chrono::seconds(t);
 }
 
+// Returns how far into its civil span (of span seconds, a divisor of a day)
+// the local time (unix_time + offset) is, computed without overflow.
+inline int64_t SecondsIntoSpan(int64_t unix_time, int32_t offset,
+                               int64_t span) {
+  const int64_t r = (unix_time % span + offset % span) % span;
+  return (r < 0) ? r + span : r;
+}
+
+// Splits a time_point into the seconds since the Unix epoch at or before
+// it, and the subsecond [0s:1s) after that.
+inline void SplitUnixTime(const time_point& tp, int64_t* unix_time,
+                          duration* subsecond) {
+  const __int128 nanos = UnixNanos(tp);
+  if (FitsInt64(nanos)) {
+    int64_t secs = static_cast<int64_t>(nanos) / kNanosPerSecond;
+    int64_t rem = static_cast<int64_t>(nanos) % kNanosPerSecond;
+    if (rem < 0) {
+      secs -= 1;
+      rem += kNanosPerSecond;
+    }
+    *unix_time = secs;
+    *subsecond = std::chrono::nanoseconds(rem);
+    return;
+  }
+  *unix_time = ToUnixSeconds(tp);
+  *subsecond = tp - FromUnixSeconds(*unix_time);
+  if (*subsecond < duration::zero()) {
+    *unix_time -= 1;
+    *subsecond += std::chrono::seconds(1);
+  }
+}
+
 }  // namespace cctz
 
 #endif  // CCTZ_IF_H_
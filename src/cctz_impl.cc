@@ -15,20 +15,62 @@
 
 #include "src/cctz_impl.h"
 
-#include <map>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
 #include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
 
 namespace cctz {
 
 namespace {
 
-// TimeZone::Impls are linked into a map to support fast lookup by name.
-typedef std::map<std::string, const TimeZone::Impl*> TimeZoneImplByName;
-TimeZoneImplByName* time_zone_map = nullptr;
+// A loaded (or failed) time-zone name, and the TimeZone::Impl it maps to.
+// Entries are immutable and never freed.
+struct ZoneEntry {
+  ZoneEntry(const std::string& n, std::size_t h, const TimeZone::Impl* i)
+      : name(n), hash(h), impl(i) {}
+  const std::string name;
+  const std::size_t hash;
+  const TimeZone::Impl* const impl;
+};
 
-// Mutual exclusion for time_zone_map.
+// TimeZone::Impls are entered into an open-addressed hash table to support
+// fast lookup by name. Slots are only ever filled, never cleared, so they
+// may be probed without a lock. When the table gets too full, a larger copy
+// is published in its stead. Readers may still be probing the old table,
+// so it is never freed, but as the tables grow geometrically the total
+// space so lost is bounded by the size of the current table.
+struct ZoneTable {
+  explicit ZoneTable(std::size_t size)
+      : mask(size - 1), slots(new std::atomic<const ZoneEntry*>[size]) {
+    for (std::size_t i = 0; i != size; ++i) slots[i].store(nullptr);
+  }
+  const std::size_t mask;  // the number of slots (a power of 2), minus 1
+  std::size_t count = 0;   // filled slots, guarded by time_zone_mutex
+  std::atomic<const ZoneEntry*>* const slots;
+};
+
+// The current table, which is only replaced under time_zone_mutex.
+std::atomic<const ZoneTable*> time_zone_table(nullptr);
+
+// Mutual exclusion for additions to time_zone_table.
 std::mutex time_zone_mutex;
 
+// The names of the zones being loaded, outside of time_zone_mutex, and the
+// signal that one of them has been entered into time_zone_table. Guarded
+// by time_zone_mutex.
+std::set<std::string>* const loading_zones = new std::set<std::string>;
+std::condition_variable time_zone_loaded;
+
 // The UTCTimeZone(). Also used for time zones that fail to load.
 const TimeZone::Impl* utc_time_zone = nullptr;
 
@@ -39,22 +81,129 @@ void LoadUTCTimeZone() {
   std::call_once(load_utc_once, []() { UTCTimeZone(); });
 }
 
-}  // namespace
+// FNV-1a, which is more than adequate for the short names of zones.
+std::size_t HashName(const char* name, std::size_t len) {
+  uint64_t h = 14695981039346656037ULL;
+  for (std::size_t i = 0; i != len; ++i) {
+    h ^= static_cast<unsigned char>(name[i]);
+    h *= 1099511628211ULL;
+  }
+  return static_cast<std::size_t>(h);
+}
 
-bool TimeZone::Impl::LoadTimeZone(const std::string& name, TimeZone* tz) {
-  const bool is_utc = (name.compare("UTC") == 0);
+// Returns the entry for the name in the table, or nullptr.
+const ZoneEntry* FindEntry(const ZoneTable* table, const char* name,
+                           std::size_t len, std::size_t hash) {
+  for (std::size_t i = hash & table->mask;; i = (i + 1) & table->mask) {
+    const ZoneEntry* entry = table->slots[i].load(std::memory_order_acquire);
+    if (entry == nullptr) return nullptr;
+    if (entry->hash == hash && entry->name.size() == len &&
+        std::memcmp(entry->name.data(), name, len) == 0) {
+      return entry;
+    }
+  }
+}
 
-  // First check, under a shared lock, whether the time zone has already
-  // been loaded. This is the common path. TODO: Move to shared_mutex.
-  {
-    std::lock_guard<std::mutex> lock(time_zone_mutex);
-    if (time_zone_map != nullptr) {
-      TimeZoneImplByName::const_iterator itr = time_zone_map->find(name);
-      if (itr != time_zone_map->end()) {
-        *tz = TimeZone(itr->second);
-        return is_utc || itr->second != utc_time_zone;
+// Adds the entry to the table, which must have room, without publishing
+// the table itself. Requires time_zone_mutex (or a private table).
+void AddEntry(ZoneTable* table, const ZoneEntry* entry) {
+  std::size_t i = entry->hash & table->mask;
+  while (table->slots[i].load(std::memory_order_relaxed) != nullptr) {
+    i = (i + 1) & table->mask;
+  }
+  table->slots[i].store(entry, std::memory_order_release);
+  table->count += 1;
+}
+
+// Returns the entry for the name in the current table, or nullptr. Needs
+// no lock.
+const ZoneEntry* LookupEntry(const char* name, std::size_t len,
+                             std::size_t hash) {
+  const ZoneTable* table = time_zone_table.load(std::memory_order_acquire);
+  return (table != nullptr) ? FindEntry(table, name, len, hash) : nullptr;
+}
+
+// Enters a new name into time_zone_table, growing it as necessary to keep
+// it no more than half full. Requires time_zone_mutex.
+void InsertEntry(const ZoneEntry* entry) {
+  ZoneTable* table =
+      const_cast<ZoneTable*>(time_zone_table.load(std::memory_order_relaxed));
+  if (table == nullptr || 2 * (table->count + 1) > table->mask + 1) {
+    ZoneTable* grown = new ZoneTable(table == nullptr ? 64
+                                                      : 2 * (table->mask + 1));
+    if (table != nullptr) {
+      for (std::size_t i = 0; i != table->mask + 1; ++i) {
+        const ZoneEntry* old = table->slots[i].load(std::memory_order_relaxed);
+        if (old != nullptr) AddEntry(grown, old);
       }
     }
+    table = grown;  // the old table is left to any concurrent readers
+    time_zone_table.store(table, std::memory_order_release);
+  }
+  AddEntry(table, entry);
+}
+
+// Enters the newly loaded impl for the name, or UTC if it failed to load
+// (i.e., impl is nullptr), and returns the new entry. Requires
+// time_zone_mutex.
+const ZoneEntry* InstallEntry(const std::string& name, std::size_t hash,
+                              bool is_utc, const TimeZone::Impl* impl) {
+  if (impl == nullptr) {
+    impl = utc_time_zone;  // fallback to UTC
+  } else if (is_utc) {
+    // Happens before any reference to utc_time_zone.
+    utc_time_zone = impl;
+  }
+  const ZoneEntry* entry = new ZoneEntry(name, hash, impl);
+  InsertEntry(entry);
+  return entry;
+}
+
+// Returns whether the entry's zone loaded, rather than falling back to UTC,
+// and counts the fallbacks.
+bool Loaded(const ZoneEntry* entry, bool is_utc) {
+  if (is_utc || entry->impl != utc_time_zone) return true;
+  CountGlobal(kUTCFallbacks);
+  return false;
+}
+
+// Marks the named zone as being loaded by this thread, from construction
+// (with time_zone_mutex held) to destruction, which takes the lock again
+// if it was released, clears the mark, and wakes any threads waiting for
+// the zone, so that they are woken however the load ends (even if
+// Create() throws) rather than waiting forever.
+class LoadingZone {
+ public:
+  LoadingZone(const std::string& name, std::unique_lock<std::mutex>* lock)
+      : name_(name), lock_(lock) {
+    loading_zones->insert(name_);
+  }
+  LoadingZone(const LoadingZone&) = delete;
+  LoadingZone& operator=(const LoadingZone&) = delete;
+  ~LoadingZone() {
+    if (!lock_->owns_lock()) lock_->lock();
+    loading_zones->erase(name_);
+    lock_->unlock();
+    time_zone_loaded.notify_all();
+  }
+
+ private:
+  const std::string& name_;
+  std::unique_lock<std::mutex>* const lock_;
+};
+
+}  // namespace
+
+bool TimeZone::Impl::LoadTimeZone(const char* name, std::size_t len,
+                                  TimeZone* tz) {
+  const bool is_utc = (len == 3 && std::memcmp(name, "UTC", 3) == 0);
+  const std::size_t hash = HashName(name, len);
+
+  // First check, without any lock, whether the time zone has already been
+  // loaded. This is the common path.
+  if (const ZoneEntry* entry = LookupEntry(name, len, hash)) {
+    *tz = TimeZone(entry->impl);
+    return Loaded(entry, is_utc);
   }
 
   if (!is_utc) {
@@ -62,50 +211,151 @@ bool TimeZone::Impl::LoadTimeZone(const std::string& name, TimeZone* tz) {
     LoadUTCTimeZone();
   }
 
-  // Now check again, under an exclusive lock.
-  std::lock_guard<std::mutex> lock(time_zone_mutex);
-  if (time_zone_map == nullptr) time_zone_map = new TimeZoneImplByName;
-  const TimeZone::Impl*& impl = (*time_zone_map)[name];
-  bool fallback_utc = false;
-  if (impl == nullptr) {
-    // The first thread in loads the new time zone.
-    TimeZone::Impl* new_impl = new TimeZone::Impl(name);
-    new_impl->zone_ = TimeZoneIf::Load(new_impl->name_);
-    if (new_impl->zone_ == nullptr) {
-      delete new_impl;       // free the nascent TimeZone::Impl
-      impl = utc_time_zone;  // and fallback to UTC
-      fallback_utc = true;
-    } else {
-      if (is_utc) {
-        // Happens before any reference to utc_time_zone.
-        utc_time_zone = new_impl;
+  // Load the new time zone without holding the lock, so that loads of
+  // other zones are not held up behind its I/O. Only one thread loads any
+  // one zone, and any others that want it wait for that.
+  const std::string zone_name(name, len);
+  std::unique_lock<std::mutex> lock(time_zone_mutex);
+  for (;;) {
+    if (const ZoneEntry* entry = LookupEntry(name, len, hash)) {
+      *tz = TimeZone(entry->impl);
+      return Loaded(entry, is_utc);
+    }
+    if (loading_zones->count(zone_name) == 0) break;
+    time_zone_loaded.wait(lock);
+  }
+  const ZoneEntry* entry = nullptr;
+  {
+    LoadingZone loading(zone_name, &lock);
+    lock.unlock();
+    const Impl* impl = Create(zone_name);
+    lock.lock();
+    entry = InstallEntry(zone_name, hash, is_utc, impl);
+  }  // the zone is entered before it is no longer marked as loading
+  *tz = TimeZone(entry->impl);
+  return Loaded(entry, is_utc);
+}
+
+std::size_t TimeZone::Impl::PreloadTimeZones(
+    const std::vector<std::string>& names) {
+  // Load the zones on a few threads, each taking the next name in turn.
+  std::atomic<std::size_t> next(0);
+  std::atomic<std::size_t> loaded(0);
+  auto load = [&names, &next, &loaded]() {
+    for (;;) {
+      const std::size_t i = next.fetch_add(1, std::memory_order_relaxed);
+      if (i >= names.size()) break;
+      TimeZone tz;
+      if (LoadTimeZone(names[i].data(), names[i].size(), &tz))
+        loaded.fetch_add(1, std::memory_order_relaxed);
+    }
+  };
+  const std::size_t kNamesPerThread = 16;
+  const std::size_t max_threads =
+      std::max(1u, std::thread::hardware_concurrency());
+  const std::size_t nthreads = std::min(
+      max_threads, (names.size() + kNamesPerThread - 1) / kNamesPerThread);
+  std::vector<std::thread> threads;
+  for (std::size_t i = 1; i < nthreads; ++i) threads.emplace_back(load);
+  load();
+  for (std::thread& thread : threads) thread.join();
+  return loaded.load(std::memory_order_relaxed);
+}
+
+std::size_t TimeZone::Impl::ReloadTimeZones() {
+  // Collect the time zones that loaded successfully, other than UTC, whose
+  // data is built in.
+  std::vector<const Impl*> impls;
+  {
+    std::lock_guard<std::mutex> lock(time_zone_mutex);
+    if (const ZoneTable* table =
+            time_zone_table.load(std::memory_order_relaxed)) {
+      for (std::size_t i = 0; i != table->mask + 1; ++i) {
+        const ZoneEntry* entry =
+            table->slots[i].load(std::memory_order_relaxed);
+        if (entry != nullptr && entry->impl != utc_time_zone)
+          impls.push_back(entry->impl);
       }
-      impl = new_impl;  // install new time zone
     }
   }
-  *tz = TimeZone(impl);
-  return !fallback_utc;
+
+  // Load each again, off to the side, and then publish the new data in a
+  // single store. Any time zone that now fails to load keeps its old data.
+  std::size_t reloaded = 0;
+  for (const Impl* impl : impls) {
+    std::unique_ptr<TimeZoneIf> zone = impl->LoadZone();
+    if (zone == nullptr) continue;
+    impl->zone_.store(Tag(zone.release()), std::memory_order_release);
+    reloaded += 1;
+  }
+  return reloaded;
 }
 
-const TimeZone::Impl& TimeZone::Impl::get(const TimeZone& tz) {
-  if (tz.impl_ == nullptr) {
-    // Dereferencing an implicit-UTC TimeZone is expected to be
-    // rare, so we don't mind paying a small synchronization cost.
-    LoadUTCTimeZone();
-    return *utc_time_zone;
+void TimeZone::Impl::CollectStats(std::vector<ZoneStats>* zones,
+                                  std::vector<std::string>* failed) {
+  std::lock_guard<std::mutex> lock(time_zone_mutex);
+  const ZoneTable* table = time_zone_table.load(std::memory_order_relaxed);
+  if (table == nullptr) return;
+  for (std::size_t i = 0; i != table->mask + 1; ++i) {
+    const ZoneEntry* entry = table->slots[i].load(std::memory_order_relaxed);
+    if (entry == nullptr) continue;
+    if (entry->impl == utc_time_zone && entry->name != "UTC") {
+      failed->push_back(entry->name);
+      continue;
+    }
+    ZoneStats stats = ZoneStats();
+    stats.name = entry->name;
+#ifdef CCTZ_STATS
+    const ZoneCounters& counters = entry->impl->counters_;
+    stats.loads = counters.Sum(kLoads);
+    stats.load_time = std::chrono::nanoseconds(counters.Sum(kLoadNanos));
+    stats.break_time = counters.Sum(kBreakTime);
+    stats.break_times_rows = counters.Sum(kBreakTimesRows);
+    stats.break_times_searches = counters.Sum(kBreakTimesSearches);
+    stats.make_time = counters.Sum(kMakeTime);
+    stats.make_times_rows = counters.Sum(kMakeTimesRows);
+    stats.make_times_searches = counters.Sum(kMakeTimesSearches);
+    stats.make_times_fallbacks = counters.Sum(kMakeTimesFallbacks);
+    stats.future_shifts = counters.Sum(kFutureShifts);
+#endif
+    zones->push_back(stats);
   }
-  return *tz.impl_;
 }
 
-TimeZone::Impl::Impl(const std::string& name) : name_(name) {}
+const TimeZoneFixed TimeZone::Impl::implicit_utc_;
 
-Breakdown TimeZone::Impl::BreakTime(const time_point& tp) const {
-  return zone_->BreakTime(tp);
+TimeZone::Impl::Impl(const std::string& name)
+    : name_(name), zone_(0) {}
+
+TimeZone::Impl* TimeZone::Impl::Create(const std::string& name) {
+  static_assert(alignof(TimeZoneInfo) > kTagMask &&
+                    alignof(TimeZoneFixed) > kTagMask,
+                "zone data must leave room for the tag");
+  Impl* impl = new Impl(name);
+  std::unique_ptr<TimeZoneIf> zone = impl->LoadZone();
+  if (zone == nullptr) {
+    delete impl;
+    return nullptr;
+  }
+  impl->zone_.store(Tag(zone.release()), std::memory_order_relaxed);
+  return impl;
 }
 
-TimeInfo TimeZone::Impl::MakeTimeInfo(int64_t year, int mon, int day,
-                                      int hour, int min, int sec) const {
-  return zone_->MakeTimeInfo(year, mon, day, hour, min, sec);
+std::unique_ptr<TimeZoneIf> TimeZone::Impl::LoadZone() const {
+#ifdef CCTZ_STATS
+  const auto start = std::chrono::steady_clock::now();
+  std::unique_ptr<TimeZoneIf> zone = TimeZoneIf::Load(name_);
+  const std::chrono::nanoseconds elapsed =
+      std::chrono::steady_clock::now() - start;
+  if (zone != nullptr) {
+    zone->set_counters(&counters_);
+    counters_.Add(kLoads, 1);
+    counters_.Add(kLoadNanos, elapsed.count());
+  }
+  return zone;
+#else
+  return TimeZoneIf::Load(name_);
+#endif
 }
 
 }  // namespace cctz
@@ -16,11 +16,19 @@
 #ifndef CCTZ_IMPL_H_
 #define CCTZ_IMPL_H_
 
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "src/cctz.h"
+#include "src/cctz_counters.h"
+#include "src/cctz_fixed.h"
+#include "src/cctz_if.h"
 #include "src/cctz_info.h"
+#include "src/cctz_stats.h"
 
 namespace cctz {
 
@@ -29,25 +37,177 @@ class TimeZone::Impl {
  public:
   // Load a named time zone. Returns false if the name is invalid, or if
   // some other kind of error occurs. Note that loading "UTC" never fails.
-  static bool LoadTimeZone(const std::string& name, TimeZone* tz);
+  static bool LoadTimeZone(const char* name, std::size_t len, TimeZone* tz);
 
-  // Dereferences the TimeZone to obtain its Impl.
-  static const TimeZone::Impl& get(const TimeZone& tz);
+  // Loads the named time zones in parallel, and returns the number of them
+  // that loaded successfully.
+  static std::size_t PreloadTimeZones(const std::vector<std::string>& names);
 
-  // Breaks a time_point down to civil-time components in this time zone.
-  Breakdown BreakTime(const time_point& tp) const;
+  // Replaces the data of every loaded time zone with a fresh load of it,
+  // and returns the number of time zones so replaced.
+  static std::size_t ReloadTimeZones();
 
-  // Converts the civil-time components in this time zone into a time_point.
+  // Appends the counts of every loaded zone to *zones, and the names that
+  // failed to load to *failed, both in no particular order.
+  static void CollectStats(std::vector<ZoneStats>* zones,
+                           std::vector<std::string>* failed);
+
+  // Returns a key for the current data of the time zone, which differs
+  // between zones, and changes when ReloadTimeZones() replaces the data.
+  static uintptr_t DataKey(const TimeZone& tz) { return Zone(tz); }
+
+  // Breaks seconds since the Unix epoch down to civil-time components in
+  // the time zone, with a zero subsecond.
+  static BreakdownLite BreakTime(const TimeZone& tz, int64_t unix_time) {
+    const uintptr_t zone = Zone(tz);
+    Count(zone, kBreakTime, 1);
+    switch (zone & kTagMask) {
+      case kInfoTag: return Info(zone)->BreakTime(unix_time);
+      case kFixedTag: return Fixed(zone)->BreakTime(unix_time);
+      default: return Other(zone)->BreakTime(unix_time);
+    }
+  }
+
+  // Breaks n seconds since the Unix epoch down into the given columns.
+  static void BreakTimes(const TimeZone& tz, const int64_t* unix_seconds,
+                         std::size_t n, const BreakdownColumns& out) {
+    const uintptr_t zone = Zone(tz);
+    Count(zone, kBreakTimesRows, n);
+    switch (zone & kTagMask) {
+      case kInfoTag: return Info(zone)->BreakTimes(unix_seconds, n, out);
+      case kFixedTag: return Fixed(zone)->BreakTimes(unix_seconds, n, out);
+      default: return Other(zone)->BreakTimes(unix_seconds, n, out);
+    }
+  }
+
+  // Returns the first second of the civil day or hour containing unix_time.
+  static int64_t StartOfSpan(const TimeZone& tz, int64_t unix_time,
+                             int64_t span) {
+    const uintptr_t zone = Zone(tz);
+    switch (zone & kTagMask) {
+      case kInfoTag: return Info(zone)->StartOfSpan(unix_time, span);
+      case kFixedTag: return Fixed(zone)->StartOfSpan(unix_time, span);
+      default: return Other(zone)->StartOfSpan(unix_time, span);
+    }
+  }
+
+  // Finds the first transition after unix_time, or the last one before it.
+  static bool NextTransition(const TimeZone& tz, int64_t unix_time,
+                             int64_t* trans) {
+    const uintptr_t zone = Zone(tz);
+    switch (zone & kTagMask) {
+      case kInfoTag: return Info(zone)->NextTransition(unix_time, trans);
+      case kFixedTag: return false;
+      default: return Other(zone)->NextTransition(unix_time, trans);
+    }
+  }
+  static bool PrevTransition(const TimeZone& tz, int64_t unix_time,
+                             int64_t* trans) {
+    const uintptr_t zone = Zone(tz);
+    switch (zone & kTagMask) {
+      case kInfoTag: return Info(zone)->PrevTransition(unix_time, trans);
+      case kFixedTag: return false;
+      default: return Other(zone)->PrevTransition(unix_time, trans);
+    }
+  }
+
+  // Converts the civil-time components in the time zone into a time_point.
   // That is, the opposite of BreakTime(). The requested civil time may be
   // ambiguous or illegal due to a change of UTC offset.
-  TimeInfo MakeTimeInfo(int64_t year, int mon, int day,
-                        int hour, int min, int sec) const;
+  static TimeInfo MakeTimeInfo(const TimeZone& tz, int64_t year, int mon,
+                               int day, int hour, int min, int sec) {
+    const uintptr_t zone = Zone(tz);
+    Count(zone, kMakeTime, 1);
+    switch (zone & kTagMask) {
+      case kInfoTag:
+        return Info(zone)->MakeTimeInfo(year, mon, day, hour, min, sec);
+      case kFixedTag:
+        return Fixed(zone)->MakeTimeInfo(year, mon, day, hour, min, sec);
+      default:
+        return Other(zone)->MakeTimeInfo(year, mon, day, hour, min, sec);
+    }
+  }
+
+  // Converts n rows of civil-time columns into seconds since the epoch.
+  static void MakeTimes(const TimeZone& tz, const CivilColumns& civil,
+                        std::size_t n, int64_t* unix_seconds,
+                        TimeInfo::Kind* kinds) {
+    const uintptr_t zone = Zone(tz);
+    Count(zone, kMakeTimesRows, n);
+    switch (zone & kTagMask) {
+      case kInfoTag:
+        return Info(zone)->MakeTimes(civil, n, unix_seconds, kinds);
+      case kFixedTag:
+        return Fixed(zone)->MakeTimes(civil, n, unix_seconds, kinds);
+      default:
+        return Other(zone)->MakeTimes(civil, n, unix_seconds, kinds);
+    }
+  }
 
  private:
   explicit Impl(const std::string& name);
 
+  // Loads the named time zone into a new Impl, or returns nullptr. This
+  // may perform I/O, so it is done outside of any lock.
+  static Impl* Create(const std::string& name);
+
+  // The data of a time zone is held as a pointer to its TimeZoneIf, with
+  // the low bits tagging the final classes that are then called directly,
+  // so that the common conversions need no virtual call.
+  static const uintptr_t kInfoTag = 1;
+  static const uintptr_t kFixedTag = 2;
+  static const uintptr_t kTagMask = 3;
+  static uintptr_t Tag(const TimeZoneIf* zone) {
+    const uintptr_t tag = (zone->kind() == TimeZoneIf::Kind::kInfo)
+                              ? kInfoTag
+                              : (zone->kind() == TimeZoneIf::Kind::kFixed)
+                                    ? kFixedTag
+                                    : 0;
+    return reinterpret_cast<uintptr_t>(zone) | tag;
+  }
+  static const TimeZoneInfo* Info(uintptr_t zone) {
+    return reinterpret_cast<const TimeZoneInfo*>(zone & ~kTagMask);
+  }
+  static const TimeZoneFixed* Fixed(uintptr_t zone) {
+    return reinterpret_cast<const TimeZoneFixed*>(zone & ~kTagMask);
+  }
+  static const TimeZoneIf* Other(uintptr_t zone) {
+    return reinterpret_cast<const TimeZoneIf*>(zone);
+  }
+
+  // Adds n to a counter of the (tagged) zone, under CCTZ_STATS.
+#ifdef CCTZ_STATS
+  static void Count(uintptr_t zone, ZoneCounter counter, uint64_t n) {
+    Other(zone & ~kTagMask)->Count(counter, n);
+  }
+#else
+  static void Count(uintptr_t, ZoneCounter, uint64_t) {}
+#endif
+
+  // Loads the data of the zone afresh, pointing it at the counters of the
+  // impl and counting the load. Returns nullptr if it fails.
+  std::unique_ptr<TimeZoneIf> LoadZone() const;
+
+  // Returns the current (tagged) data of the time zone, which for a
+  // default-constructed TimeZone is the constant implicit_utc_, and which
+  // ReloadTimeZones() may otherwise replace at any time. Replaced data may
+  // still be in use by other threads, so it is never freed (and so need not
+  // be owned).
+  static uintptr_t Zone(const TimeZone& tz) {
+    if (tz.impl_ == nullptr) {
+      return reinterpret_cast<uintptr_t>(&implicit_utc_) | kFixedTag;
+    }
+    return tz.impl_->zone_.load(std::memory_order_acquire);
+  }
+
+  // The data of the implicit UTC, which needs no load.
+  static const TimeZoneFixed implicit_utc_;
+
   const std::string name_;
-  std::unique_ptr<TimeZoneIf> zone_;
+  mutable std::atomic<uintptr_t> zone_;
+#ifdef CCTZ_STATS
+  mutable ZoneCounters counters_;  // shared by all the loads of the zone
+#endif
 };
 
 }  // namespace cctz
@@ -33,32 +33,28 @@
 
 #include "src/cctz_info.h"
 
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include <algorithm>
 #include <cerrno>
 #include <chrono>
 #include <cstdint>
-#include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <iostream>
 #include <limits>
 
+#include "src/cctz_days.h"
 #include "src/cctz_posix.h"
 
 namespace cctz {
 
 namespace {
 
-// Wrap the tzfile.h isleap() macro with an inline function, which will
-// then have normal argument-passing semantics (i.e., single evaluation).
-inline bool IsLeap(int64_t year) { return isleap(year); }
-
-// The month lengths in non-leap and leap years respectively.
-const int8_t kDaysPerMonth[2][1 + MONSPERYEAR] = {
-  {-1, 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31},
-  {-1, 31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31},
-};
-
 // The day offsets of the beginning of each (1-based) month in non-leap
 // and leap years respectively. That is, sigma[1:n]:kDaysPerMonth[][i].
 // For example, in a leap year there are 335 days before December.
@@ -70,96 +66,19 @@ const int16_t kMonthOffsets[2][1 + MONSPERYEAR + 1] = {
 // 400-year chunks always have 146097 days (20871 weeks).
 const int64_t kSecPer400Years = 146097LL * SECSPERDAY;
 
-// The number of seconds in an aligned 100-year chunk, for those that
-// do not begin with a leap year and those that do respectively.
-const int64_t kSecPer100Years[2] = {
-  (76LL * DAYSPERNYEAR + 24LL * DAYSPERLYEAR) * SECSPERDAY,
-  (75LL * DAYSPERNYEAR + 25LL * DAYSPERLYEAR) * SECSPERDAY,
-};
-
-// The number of seconds in an aligned 4-year chunk, for those that
-// do not begin with a leap year and those that do respectively.
-const int32_t kSecPer4Years[2] = {
-  (4 * DAYSPERNYEAR + 0 * DAYSPERLYEAR) * SECSPERDAY,
-  (3 * DAYSPERNYEAR + 1 * DAYSPERLYEAR) * SECSPERDAY,
-};
-
-// The number of seconds in non-leap and leap years respectively.
-const int32_t kSecPerYear[2] = {
-  DAYSPERNYEAR * SECSPERDAY,
-  DAYSPERLYEAR * SECSPERDAY,
-};
-
-// The number of days in the 100 years starting in the mod-400 index year,
-// stored as a 36524-deficit value (i.e., 0 == 36524, 1 == 36525).
-const int8_t kDaysPer100Years[401] = {
-  1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
-  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
-  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
-  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
-  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
-};
-
-inline int DaysPer100Years(int eyear) {
-  return 36524 + kDaysPer100Years[eyear];
-}
-
-// The number of days in the 4 years starting in the mod-400 index year,
-// stored as a 1460-deficit value (i.e., 0 == 1460, 1 == 1461).
-const int8_t kDaysPer4Years[401] = {
-  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
-  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
-  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
-  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
-  1, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
-  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
-  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
-  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
-  1, 1, 1, 1, 1, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
-  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
-  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
-  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
-  1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
-  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
-  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
-  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
-  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
-};
-
-inline int DaysPer4Years(int eyear) { return 1460 + kDaysPer4Years[eyear]; }
-
-// Like kSecPerYear[] but scaled down by a factor of SECSPERDAY.
-const int32_t kDaysPerYear[2] = {DAYSPERNYEAR, DAYSPERLYEAR};
-
-inline int DaysPerYear(int year) { return kDaysPerYear[IsLeap(year)]; }
+// The number of years past the last zic transition for which transitions
+// are generated from the future specification. Later years are mapped
+// back into that range using the 400-year cycle of calendaric equivalence.
+const int32_t kFutureYears = 400;
 
 // Year limits beyond which DayOrdinal() may encounter integer overflow.
 // Each is well outside the realistic year range.
 const int64_t kDayOrdYearMax =  25252734927766553LL;
 const int64_t kDayOrdYearMin = -25252734927764584LL;
 
-// Map a (normalized) Y/M/D to the number of days before/after 1970-01-01.
-// See http://howardhinnant.github.io/date_algorithms.html#days_from_civil.
-int64_t DayOrdinal(int64_t year, int month, int day) {
-  year -= (month <= 2 ? 1 : 0);
-  const int64_t era = (year >= 0 ? year : year - 399) / 400;
-  const int yoe = year - era * 400;
-  const int doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
-  const int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
-  return era * 146097 + doe - 719468;  // shift epoch to 1970-01-01
-}
+// DayOrdinal() values for the last and first days within those limits.
+const int64_t kDayOrdMax = 9223372036854056071LL;   // kDayOrdYearMax/12/31
+const int64_t kDayOrdMin = -9223372036854775600LL;  // kDayOrdYearMin/01/01
 
 // Normalize (*valp + carry_in) so that [zero <= *valp < (zero + base)],
 // returning multiples of base to carry out. "zero" must be >= 0, and
@@ -256,9 +175,10 @@ inline TimeInfo MakeUnique(__int128 unix_time, bool normalized) {
 inline TimeInfo MakeSkipped(const Transition& tr, const DateTime& dt,
                             bool normalized) {
   TimeInfo ti;
-  ti.pre = FromTimeT(tr.unix_time - 1 + (dt - tr.prev_date_time), &normalized);
+  ti.pre = FromTimeT(tr.unix_time - 1 + (dt.offset - tr.prev_date_time),
+                     &normalized);
   ti.trans = FromTimeT(tr.unix_time, &normalized);
-  ti.post = FromTimeT(tr.unix_time - (tr.date_time - dt), &normalized);
+  ti.post = FromTimeT(tr.unix_time - (tr.date_time - dt.offset), &normalized);
   ti.kind = TimeInfo::Kind::SKIPPED;
   ti.normalized = normalized;
   return ti;
@@ -267,14 +187,39 @@ inline TimeInfo MakeSkipped(const Transition& tr, const DateTime& dt,
 inline TimeInfo MakeRepeated(const Transition& tr, const DateTime& dt,
                              bool normalized) {
   TimeInfo ti;
-  ti.pre = FromTimeT(tr.unix_time - 1 - (tr.prev_date_time - dt), &normalized);
+  ti.pre = FromTimeT(tr.unix_time - 1 - (tr.prev_date_time - dt.offset),
+                     &normalized);
   ti.trans = FromTimeT(tr.unix_time, &normalized);
-  ti.post = FromTimeT(tr.unix_time + (dt - tr.date_time), &normalized);
+  ti.post = FromTimeT(tr.unix_time + (dt.offset - tr.date_time), &normalized);
   ti.kind = TimeInfo::Kind::REPEATED;
   ti.normalized = normalized;
   return ti;
 }
 
+// The number of times converted together by TimeZoneInfo::BreakTimes(),
+// which bounds the size of its scratch arrays.
+const std::size_t kBlockSize = 256;
+
+// TimeZoneInfo::MakeTimes() computes the local date/times of rows with
+// in-range fields in 64 bits, which is safe for years of this magnitude.
+const int64_t kMaxFastYear = 1000000000;
+
+// The time of the zic "BIG_BANG" transition, which sets the initial type
+// of the zone from the beginning of time, rather than changing it.
+const int64_t kBigBang = -(1LL << 59);
+
+// TimeZoneInfo::StartOfSpan() takes the start of a span from the offset in
+// effect when the span begins at least this long after the transition to
+// that offset, which is more than any change in UTC offset, so that no
+// earlier time can share the span's civil time.
+const int64_t kMaxOffsetChange = 2 * SECSPERDAY;
+
+// Copies n elements from src to dst, unless dst is null.
+template <typename T>
+void CopyColumn(const T* src, std::size_t n, T* dst) {
+  if (dst != nullptr) std::copy(src, src + n, dst);
+}
+
 }  // namespace
 
 // Normalize from individual date/time fields.
@@ -286,93 +231,89 @@ bool DateTime::Normalize(int64_t year, int mon, int day,
   int year_carry = NormalizeField(MONSPERYEAR, 1, &mon, 0);
   bool normalized = min_carry || hour_carry || day_carry || year_carry;
 
-  // Normalize the number of days within a 400-year (146097-day) period.
-  if (int c4_carry = NormalizeField(146097, 1, &day, day_carry)) {
-    year_carry += c4_carry * 400;
-    normalized = true;
-  }
-
-  // Extract a [0:399] year calendrically equivalent to (year + year_carry)
-  // from that sum in order to simplify year/day normalization and to defer
-  // the possibility of int64_t overflow until the final stage.
-  int eyear = year % 400;
-  if (year_carry != 0) { eyear += year_carry; eyear %= 400; }
-  if (eyear < 0) eyear += 400;
-  year_carry -= eyear;
-
-  int orig_day = day;
-  if (day > DAYSPERNYEAR) {
-    eyear += (mon > 2 ? 1 : 0);
-    if (day > 146097 - DAYSPERNYEAR) {
-      // We often hit the 400th year when stepping a civil time backwards,
-      // so special case it to avoid counting up by 100/4/1 year chunks.
-      day = DaysPerYear(eyear += 400 - 1) - (146097 - day);
-    } else {
-      // Handle days in chunks of 100/4/1 years.
-      for (int ydays = DaysPer100Years(eyear); day > ydays;
-           day -= ydays, ydays = DaysPer100Years(eyear)) {
-        if ((eyear += 100) > 400) { eyear -= 400; year_carry += 400; }
-      }
-      for (int ydays = DaysPer4Years(eyear); day > ydays;
-           day -= ydays, ydays = DaysPer4Years(eyear)) {
-        if ((eyear += 4) > 400) { eyear -= 400; year_carry += 400; }
-      }
-      for (int ydays = DaysPerYear(eyear); day > ydays;
-           day -= ydays, ydays = DaysPerYear(eyear)) {
-        eyear += 1;
-      }
-    }
-    eyear -= (mon > 2 ? 1 : 0);
-  }
-  // Handle days within one year.
-  bool leap_year = IsLeap(eyear);
-  for (int mdays = kDaysPerMonth[leap_year][mon]; day > mdays;
-       day -= mdays, mdays = kDaysPerMonth[leap_year][mon]) {
-    if (++mon > MONSPERYEAR) { mon = 1; leap_year = IsLeap(++eyear); }
-  }
-  if (day != orig_day) normalized = true;
-
-  // Add the updated eyear back into (year + year_carry).
-  year_carry += eyear;
+  // The day may be any number of days from the first of the (normalized)
+  // month, which the closed-form DayOrdinal() handles directly. We work
+  // in 128 bits to defer the possibility of overflow until the final stage.
+  const __int128 eyear = static_cast<__int128>(year) + year_carry;
+  const bool leap_year = IsLeap(static_cast<int64_t>(eyear % 400));
+  if (day < 1 || day > kDaysPerMonth[leap_year][mon]) normalized = true;
+  const __int128 days =
+      DayOrdinal(eyear, mon, 1) + (static_cast<__int128>(day) - 1) + day_carry;
 
   // Finally, set the DateTime offset. If the requested time is beyond
   // the limits of our encoding (which is already far beyond the bounds of
   // time_point), store a saturated offset.
-  if (year > kDayOrdYearMax - year_carry) {
+  if (days > kDayOrdMax) {
     offset = static_cast<__int128>(-1) >> 1;
-  } else if (year < kDayOrdYearMin - year_carry) {
+  } else if (days < kDayOrdMin) {
     offset = (static_cast<__int128>(-1) >> 1) + 1;
   } else {
-    offset = DayOrdinal(year + year_carry, mon, day);
-    offset *= SECSPERHOUR * HOURSPERDAY;
+    offset = days * (SECSPERHOUR * HOURSPERDAY);
     offset += hour * SECSPERHOUR + min * SECSPERMIN + sec;
   }
   return normalized;
 }
 
-// Assign from a Breakdown, created using a TimeZoneInfo timestamp.
-inline void DateTime::Assign(const Breakdown& bd) {
-  Normalize(bd.year, bd.month, bd.day, bd.hour, bd.minute, bd.second);
+void TransitionIndex::Build(const int64_t* keys, int32_t count) {
+  // Only index the keys that are reasonably close to the last one.
+  const int64_t kMaxSpan = 1LL << 40;  // about 35000 years
+  first_ = 0;
+  while (first_ < count - 1 &&
+         static_cast<uint64_t>(keys[count - 1] - keys[first_]) > kMaxSpan) {
+    ++first_;
+  }
+  base_ = (count != 0) ? keys[first_] : 0;
+  const int64_t span = (count != 0) ? keys[count - 1] - base_ : 0;
+  const int64_t max_buckets = 2 * std::max(count - first_, 1);
+  shift_ = 0;
+  while ((span >> shift_) >= max_buckets) ++shift_;
+  const int64_t nbuckets = (span >> shift_) + 1;
+  buckets_.resize(nbuckets + 1);
+  int32_t ub = first_;
+  for (int64_t bucket = 0; bucket != nbuckets; ++bucket) {
+    const int64_t key = base_ + (bucket << shift_);
+    while (ub != count && !(key < keys[ub])) ++ub;
+    buckets_[bucket] = ub;
+  }
+  buckets_[nbuckets] = count;
 }
 
 // What (no leap-seconds) UTC+seconds zoneinfo would look like.
 void TimeZoneInfo::ResetToBuiltinUTC(int seconds) {
-  transition_types_.resize(1);
-  transition_types_[0].utc_offset = seconds;
-  transition_types_[0].is_dst = false;
-  transition_types_[0].abbr_index = 0;
-  transitions_.resize(1);
-  transitions_[0].unix_time = -(1LL << 59);  // zic "BIG_BANG"
-  transitions_[0].type_index = 0;
-  transitions_[0].date_time.Assign(LocalTime(
-      transitions_[0].unix_time, duration::zero(), transition_types_[0]));
-  transitions_[0].prev_date_time = transitions_[0].date_time;
-  transitions_[0].prev_date_time.offset -= 1;
+  type_storage_.resize(1);
+  type_storage_[0].utc_offset = seconds;
+  type_storage_[0].is_dst = false;
+  type_storage_[0].abbr_index = 0;
+  TransitionStorage& st = transition_storage_;
+  st.resize(1);
+  st.unix_time[0] = kBigBang;
+  st.type_index[0] = 0;
+  st.date_time[0] = st.unix_time[0] + seconds;
+  st.prev_date_time[0] = st.date_time[0] - 1;
   default_transition_type_ = 0;
-  abbreviations_ = "UTC";  // TODO: handle non-zero offset
-  abbreviations_.append(1, '\0');  // add NUL
+  abbr_storage_ = "UTC";  // TODO: handle non-zero offset
+  abbr_storage_.append(1, '\0');  // add NUL
   future_spec_.clear();  // never needed for a fixed-offset zone
   extended_ = false;
+  UseStorage();
+  BuildIndexes();
+}
+
+void TimeZoneInfo::UseStorage() {
+  const TransitionStorage& st = transition_storage_;
+  transitions_.unix_time = st.unix_time.data();
+  transitions_.type_index = st.type_index.data();
+  transitions_.date_time = st.date_time.data();
+  transitions_.prev_date_time = st.prev_date_time.data();
+  transitions_.count = static_cast<int32_t>(st.unix_time.size());
+  transition_types_ = type_storage_.data();
+  abbreviations_ = abbr_storage_.data();
+}
+
+// Builds the BreakTime() and MakeTimeInfo() search indexes.
+void TimeZoneInfo::BuildIndexes() {
+  unix_time_index_.Build(transitions_.unix_time, transitions_.size());
+  date_time_index_.Build(transitions_.date_time, transitions_.size());
 }
 
 // Builds the in-memory header using the raw bytes from the file.
@@ -411,11 +352,18 @@ size_t TimeZoneInfo::Header::DataLength(size_t time_len) const {
   return len;
 }
 
-bool TimeZoneInfo::Load(const std::string& name, FILE* fp) {
+bool TimeZoneInfo::Load(const std::string& name,
+                        const char* data, size_t size) {
+  // The undecoded data is [bp ... ep).
+  const char* bp = data;
+  const char* const ep = data + size;
+
   // Read and validate the header.
   tzhead tzh;
-  if (fread(&tzh, 1, sizeof tzh, fp) != sizeof tzh)
+  if (static_cast<size_t>(ep - bp) < sizeof tzh)
     return false;
+  memcpy(&tzh, bp, sizeof tzh);
+  bp += sizeof tzh;
   if (strncmp(tzh.tzh_magic, TZ_MAGIC, sizeof(tzh.tzh_magic)) != 0)
     return false;
   Header hdr;
@@ -423,11 +371,15 @@ bool TimeZoneInfo::Load(const std::string& name, FILE* fp) {
   size_t time_len = 4;
   if (tzh.tzh_version[0] != '\0') {
     // Skip the 4-byte data.
-    if (fseek(fp, hdr.DataLength(time_len), SEEK_CUR) != 0)
+    const size_t skip = hdr.DataLength(time_len);
+    if (static_cast<size_t>(ep - bp) < skip)
       return false;
+    bp += skip;
     // Read and validate the header for the 8-byte data.
-    if (fread(&tzh, 1, sizeof tzh, fp) != sizeof tzh)
+    if (static_cast<size_t>(ep - bp) < sizeof tzh)
       return false;
+    memcpy(&tzh, bp, sizeof tzh);
+    bp += sizeof tzh;
     if (strncmp(tzh.tzh_magic, TZ_MAGIC, sizeof(tzh.tzh_magic)) != 0)
       return false;
     if (tzh.tzh_version[0] == '\0')
@@ -449,44 +401,48 @@ bool TimeZoneInfo::Load(const std::string& name, FILE* fp) {
   if (hdr.ttisgmtcnt != 0 && hdr.ttisgmtcnt != hdr.typecnt)
     return false;
 
-  // Read the data into a local buffer.
-  size_t len = hdr.DataLength(time_len);
-  std::vector<char> tbuf(len);
-  if (fread(tbuf.data(), 1, len, fp) != len)
+  // Check that the data is all there, so that it can be decoded in place.
+  const size_t len = hdr.DataLength(time_len);
+  if (static_cast<size_t>(ep - bp) < len)
     return false;
-  const char* bp = tbuf.data();
 
   // Decode and validate the transitions.
-  transitions_.resize(hdr.timecnt);
+  TransitionStorage& st = transition_storage_;
+  st.resize(hdr.timecnt);
   for (int32_t i = 0; i != hdr.timecnt; ++i) {
-    transitions_[i].unix_time = (time_len == 4) ? Decode32(bp) : Decode64(bp);
+    const int64_t unix_time = (time_len == 4) ? Decode32(bp) : Decode64(bp);
     bp += time_len;
+    // Keep the local date/times within 64 bits (see Transitions).
+    if (unix_time <= INT64_MIN + SECSPERDAY ||
+        unix_time >= INT64_MAX - SECSPERDAY)
+      return false;
     if (i != 0) {
       // Check that the transitions are ordered by time (as zic guarantees).
-      if (!Transition::ByUnixTime()(transitions_[i - 1], transitions_[i]))
+      if (!(st.unix_time[i - 1] < unix_time))
         return false;  // out of order
     }
+    st.unix_time[i] = unix_time;
   }
   bool seen_type_0 = false;
   for (int32_t i = 0; i != hdr.timecnt; ++i) {
-    transitions_[i].type_index = (static_cast<uint8_t>(*bp++) & 0xff);
-    if (transitions_[i].type_index >= hdr.typecnt)
+    st.type_index[i] = (static_cast<uint8_t>(*bp++) & 0xff);
+    if (st.type_index[i] >= hdr.typecnt)
       return false;
-    if (transitions_[i].type_index == 0)
+    if (st.type_index[i] == 0)
       seen_type_0 = true;
   }
 
   // Decode and validate the transition types.
-  transition_types_.resize(hdr.typecnt);
+  type_storage_.resize(hdr.typecnt);
   for (int32_t i = 0; i != hdr.typecnt; ++i) {
-    transition_types_[i].utc_offset = Decode32(bp);
-    if (transition_types_[i].utc_offset >= SECSPERDAY ||
-        transition_types_[i].utc_offset <= -SECSPERDAY)
+    type_storage_[i].utc_offset = Decode32(bp);
+    if (type_storage_[i].utc_offset >= SECSPERDAY ||
+        type_storage_[i].utc_offset <= -SECSPERDAY)
       return false;
     bp += 4;
-    transition_types_[i].is_dst = ((static_cast<uint8_t>(*bp++) & 0xff) != 0);
-    transition_types_[i].abbr_index = (static_cast<uint8_t>(*bp++) & 0xff);
-    if (transition_types_[i].abbr_index >= hdr.charcnt)
+    type_storage_[i].is_dst = ((static_cast<uint8_t>(*bp++) & 0xff) != 0);
+    type_storage_[i].abbr_index = (static_cast<uint8_t>(*bp++) & 0xff);
+    if (type_storage_[i].abbr_index >= hdr.charcnt)
       return false;
   }
 
@@ -494,20 +450,21 @@ bool TimeZoneInfo::Load(const std::string& name, FILE* fp) {
   default_transition_type_ = 0;
   if (seen_type_0 && hdr.timecnt != 0) {
     uint8_t index = 0;
-    if (transition_types_[0].is_dst) {
-      index = transitions_[0].type_index;
-      while (index != 0 && transition_types_[index].is_dst)
+    if (type_storage_[0].is_dst) {
+      index = st.type_index[0];
+      while (index != 0 && type_storage_[index].is_dst)
         --index;
     }
-    while (index != hdr.typecnt && transition_types_[index].is_dst)
+    while (index != hdr.typecnt && type_storage_[index].is_dst)
       ++index;
     if (index != hdr.typecnt)
       default_transition_type_ = index;
   }
 
   // Copy all the abbreviations.
-  abbreviations_.assign(bp, hdr.charcnt);
+  abbr_storage_.assign(bp, hdr.charcnt);
   bp += hdr.charcnt;
+  UseStorage();
 
   // Skip the unused portions. We've already dispensed with leap-second
   // encoded zoneinfo. The ttisstd/ttisgmt indicators only apply when
@@ -521,13 +478,14 @@ bool TimeZoneInfo::Load(const std::string& name, FILE* fp) {
   if (tzh.tzh_version[0] != '\0') {
     // Snarf up the NL-enclosed future POSIX spec. Note
     // that version '3' files utilize an extended format.
-    if (fgetc(fp) != '\n')
+    if (bp == ep || *bp++ != '\n')
       return false;
-    for (int c = fgetc(fp); c != '\n'; c = fgetc(fp)) {
-      if (c == EOF)
-        return false;
-      future_spec_.push_back(c);
-    }
+    const char* const spec = bp;
+    while (bp != ep && *bp != '\n')
+      ++bp;
+    if (bp == ep)
+      return false;
+    future_spec_.assign(spec, bp - spec);
   }
 
   // We don't check for EOF so that we're forwards compatible.
@@ -543,88 +501,104 @@ bool TimeZoneInfo::Load(const std::string& name, FILE* fp) {
       // The future specification should match the last/default transition,
       // and that means that handling the future will fall out naturally.
       int index = default_transition_type_;
-      if (hdr.timecnt != 0) index = transitions_[hdr.timecnt - 1].type_index;
+      if (hdr.timecnt != 0) index = transitions_.type_index[hdr.timecnt - 1];
       const TransitionType& tt(transition_types_[index]);
       CheckTransition(name, tt, posix.std_offset, false, posix.std_abbr);
     } else if (hdr.timecnt < 2) {
       std::clog << name << ": Too few transitions for POSIX spec\n";
-    } else if (transitions_[hdr.timecnt - 1].unix_time < 0) {
+    } else if (transitions_.unix_time[hdr.timecnt - 1] < 0) {
       std::clog << name << ": Old transitions for POSIX spec\n";
     } else {  // std and dst
       // Extend the transitions for an additional 400 years using the
       // future specification. Years beyond those can be handled by
       // mapping back to a cycle-equivalent year within that range.
-      // zic(8) should probably do this so that we don't have to.
-      transitions_.resize(hdr.timecnt + 400 * 2);
+      // zic(8) should probably do this so that we don't have to. The
+      // extra transitions are generated on demand (see GetTransition()).
       extended_ = true;
 
       // The future specification should match the last two transitions,
       // and those transitions should have different is_dst flags but be
       // in the same calendar year.
-      const Transition& tr0(transitions_[hdr.timecnt - 1]);
-      const Transition& tr1(transitions_[hdr.timecnt - 2]);
-      const TransitionType& tt0(transition_types_[tr0.type_index]);
-      const TransitionType& tt1(transition_types_[tr1.type_index]);
+      const int64_t tr0_unix_time = transitions_.unix_time[hdr.timecnt - 1];
+      const int64_t tr1_unix_time = transitions_.unix_time[hdr.timecnt - 2];
+      const uint8_t tr0_type_index = transitions_.type_index[hdr.timecnt - 1];
+      const uint8_t tr1_type_index = transitions_.type_index[hdr.timecnt - 2];
+      const TransitionType& tt0(transition_types_[tr0_type_index]);
+      const TransitionType& tt1(transition_types_[tr1_type_index]);
       const TransitionType& spring(tt0.is_dst ? tt0 : tt1);
       const TransitionType& autumn(tt0.is_dst ? tt1 : tt0);
       CheckTransition(name, spring, posix.dst_offset, true, posix.dst_abbr);
       CheckTransition(name, autumn, posix.std_offset, false, posix.std_abbr);
-      last_year_ = LocalTime(tr0.unix_time, duration::zero(), tt0).year;
-      if (LocalTime(tr1.unix_time, duration::zero(), tt1).year != last_year_) {
+      last_year_ = LocalTime(tr0_unix_time, tt0).year;
+      if (LocalTime(tr1_unix_time, tt1).year != last_year_) {
         std::clog << name << ": Final transitions not in same year\n";
       }
 
-      // Add the transitions to tr1 and back to tr0 for each extra year.
-      const PosixTransition& pt1(tt0.is_dst ? posix.dst_end : posix.dst_start);
-      const PosixTransition& pt0(tt0.is_dst ? posix.dst_start : posix.dst_end);
-      Transition* tr = &transitions_[hdr.timecnt];  // next trans to fill
-      const int64_t jan1_ord = DayOrdinal(last_year_, 1, 1);
-      int64_t jan1_time = jan1_ord * SECSPERDAY;
-      int jan1_weekday = (EPOCH_WDAY + jan1_ord) % DAYSPERWEEK;
-      if (jan1_weekday < 0) jan1_weekday += DAYSPERWEEK;
-      bool leap_year = IsLeap(last_year_);
-      for (const int64_t limit = last_year_ + 400; last_year_ < limit;) {
-        last_year_ += 1;  // an additional year of generated transitions
-        jan1_time += kSecPerYear[leap_year];
-        jan1_weekday = (jan1_weekday + kDaysPerYear[leap_year]) % DAYSPERWEEK;
-        leap_year = !leap_year && IsLeap(last_year_);
-        const int64_t tr1_offset = TransOffset(leap_year, jan1_weekday, pt1);
-        tr->unix_time = jan1_time + tr1_offset - tt0.utc_offset;
-        tr++->type_index = tr1.type_index;
-        const int64_t tr0_offset = TransOffset(leap_year, jan1_weekday, pt0);
-        tr->unix_time = jan1_time + tr0_offset - tt1.utc_offset;
-        tr++->type_index = tr0.type_index;
-      }
+      // Each extra year has a transition to tr1 and then back to tr0.
+      future_rules_[0].pt = tt0.is_dst ? posix.dst_end : posix.dst_start;
+      future_rules_[0].type_index = tr1_type_index;
+      future_rules_[0].prev_utc_offset = tt0.utc_offset;
+      future_rules_[1].pt = tt0.is_dst ? posix.dst_start : posix.dst_end;
+      future_rules_[1].type_index = tr0_type_index;
+      future_rules_[1].prev_utc_offset = tt1.utc_offset;
+      first_year_ = last_year_;
+      last_year_ = first_year_ + kFutureYears;
     }
   }
 
   // Compute the local civil time for each transition and the preceeding
   // second. These will be used for reverse conversions in MakeTimeInfo().
-  const TransitionType* ttp = &transition_types_[default_transition_type_];
-  for (size_t i = 0; i != transitions_.size(); ++i) {
-    Transition& tr(transitions_[i]);
-    tr.prev_date_time.Assign(LocalTime(tr.unix_time, duration::zero(), *ttp));
-    tr.prev_date_time.offset -= 1;
-    ttp = &transition_types_[tr.type_index];
-    tr.date_time.Assign(LocalTime(tr.unix_time, duration::zero(), *ttp));
+  // A civil time in "+offset" looks like (time+offset) in UTC, so these
+  // are just the DateTime offsets of (unix_time + utc_offset).
+  int32_t utc_offset = transition_types_[default_transition_type_].utc_offset;
+  for (int32_t i = 0; i != transitions_.size(); ++i) {
+    const int64_t unix_time = transitions_.unix_time[i];
+    st.prev_date_time[i] = unix_time + utc_offset - 1;
+    utc_offset = transition_types_[transitions_.type_index[i]].utc_offset;
+    st.date_time[i] = unix_time + utc_offset;
     if (i != 0) {
       // Check that the transitions are ordered by date/time. Essentially
       // this means that an offset change cannot cross another such change.
       // No one does this in practice, and we depend on it in MakeTimeInfo().
-      if (!Transition::ByDateTime()(transitions_[i - 1], tr))
+      if (!(transitions_.date_time[i - 1] < transitions_.date_time[i]))
         return false;  // out of order
     }
   }
 
-  // We remember the transitions found during the last BreakTime() and
-  // MakeTimeInfo() calls. If the next request is for the same transition
-  // we will avoid re-searching.
-  local_time_hint_ = 0;
-  time_local_hint_ = 0;
+  if (extended_) {
+    // Also check the (soon to be) generated transitions, so that we reject
+    // any future specification that would move local time backwards.
+    Transition prev = GetTransition(hdr.timecnt - 1);
+    for (int32_t i = hdr.timecnt; i != hdr.timecnt + kFutureYears * 2; ++i) {
+      const Transition tr = GetTransition(i);
+      if (!(prev.date_time < tr.date_time))
+        return false;  // out of order
+      prev = tr;
+    }
+    future_last_ = prev;
+  }
 
+  BuildIndexes();
   return true;
 }
 
+// For files that cannot be mapped (e.g., pipes), reads the whole of the
+// data into a local buffer instead.
+bool TimeZoneInfo::LoadFromDescriptor(const std::string& name, int fd) {
+  std::vector<char> buf;
+  char chunk[4096];
+  for (;;) {
+    const ssize_t n = read(fd, chunk, sizeof chunk);
+    if (n == 0) break;
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    buf.insert(buf.end(), chunk, chunk + n);
+  }
+  return Load(name, buf.data(), buf.size());
+}
+
 bool TimeZoneInfo::Load(const std::string& name) {
   // We can ensure that the loading of UTC or any other fixed-offset
   // zone never fails because the simple, no-transition state can be
@@ -635,6 +609,13 @@ bool TimeZoneInfo::Load(const std::string& name) {
     return true;
   }
 
+  // Prefer any precompiled zone bundle to the individual zoneinfo files.
+  if (name != "localtime" && LoadFromBundle(name)) return true;
+
+  return LoadFile(name);
+}
+
+bool TimeZoneInfo::LoadFile(const std::string& name) {
   // Map time-zone name to its machine-specific path.
   std::string path;
   if (name == "localtime") {
@@ -647,11 +628,25 @@ bool TimeZoneInfo::Load(const std::string& name) {
     path += name;
   }
 
-  // Load the time-zone data.
+  // Load the time-zone data, decoding it directly from a read-only mapping
+  // of the file where possible, rather than copying it through stdio.
   bool loaded = false;
-  if (FILE* fp = fopen(path.c_str(), "r")) {
-    loaded = Load(name, fp);
-    fclose(fp);
+  const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd != -1) {
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+      const size_t size = static_cast<size_t>(st.st_size);
+      void* const addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (addr != MAP_FAILED) {
+        loaded = Load(name, static_cast<const char*>(addr), size);
+        munmap(addr, size);
+      } else {
+        loaded = LoadFromDescriptor(name, fd);
+      }
+    } else {
+      loaded = LoadFromDescriptor(name, fd);
+    }
+    close(fd);
   } else {
     char ebuf[64] = "Failed to open";
     strerror_r(errno, ebuf, sizeof ebuf);
@@ -660,99 +655,289 @@ bool TimeZoneInfo::Load(const std::string& name) {
   return loaded;
 }
 
-// BreakTime() translation for a particular transition type.
-Breakdown TimeZoneInfo::LocalTime(int64_t unix_time, duration subsecond,
-                                  const TransitionType& tt) const {
-  Breakdown bd;
-
-  bd.year = EPOCH_YEAR;
-  bd.weekday = EPOCH_WDAY;  // Thu
-  int64_t seconds = unix_time;
-
-  // Shift to a base year that is 400-year aligned.
-  static_assert(EPOCH_YEAR == 1970, "Unexpected value for EPOCH_YEAR");
-  if (seconds >= 0) {
-    seconds -= 10957LL * SECSPERDAY;
-    bd.year += 30;  // == 2000
-  } else {
-    seconds += (146097LL - 10957LL) * SECSPERDAY;
-    bd.year -= 370;  // == 1600
+namespace {
+
+// Appends to *names the zones in the tree at dir/prefix, recognizing them
+// by the TZif magic.
+void FindZoneFiles(const std::string& dir, const std::string& prefix,
+                   std::vector<std::string>* names) {
+  const std::string path = prefix.empty() ? dir : dir + '/' + prefix;
+  DIR* dp = opendir(path.c_str());
+  if (dp == nullptr) return;
+  while (const dirent* de = readdir(dp)) {
+    const std::string base = de->d_name;
+    if (base == "." || base == "..") continue;
+    const std::string name = prefix.empty() ? base : prefix + '/' + base;
+    if (name == "posix" || name == "right") continue;
+    if (name == "localtime" || name == "posixrules") continue;
+    const std::string file = dir + '/' + name;
+    struct stat st;
+    if (stat(file.c_str(), &st) != 0) continue;
+    if (S_ISDIR(st.st_mode)) {
+      FindZoneFiles(dir, name, names);
+    } else if (S_ISREG(st.st_mode)) {
+      const int fd = open(file.c_str(), O_RDONLY | O_CLOEXEC);
+      if (fd == -1) continue;
+      char magic[sizeof(TZ_MAGIC) - 1];
+      const ssize_t n = read(fd, magic, sizeof magic);
+      if (n == static_cast<ssize_t>(sizeof magic) &&
+          std::memcmp(magic, TZ_MAGIC, sizeof magic) == 0)
+        names->push_back(name);
+      close(fd);
+    }
   }
-  bd.weekday += 2;  // Sat
+  closedir(dp);
+}
 
-  // A civil time in "+offset" looks like (time+offset) in UTC.
-  if (seconds >= 0) {
-    if (tt.utc_offset > 0 && seconds > INT64_MAX - tt.utc_offset) {
-      seconds -= kSecPer400Years;
-      bd.year += 400;
+}  // namespace
+
+std::vector<std::string> TimeZoneInfo::ZoneNames() {
+  const char* tzdir = std::getenv("TZDIR");
+  std::vector<std::string> names;
+  FindZoneFiles(tzdir ? tzdir : "/usr/share/zoneinfo", "", &names);
+  std::sort(names.begin(), names.end());
+  return names;
+}
+
+namespace {
+
+// The fixed part of a zone within a bundle, which is followed by its
+// tables in the in-memory layout. Offsets are from the start of the bundle.
+struct BundleRecord {
+  uint32_t record_size;  // sizeof(BundleRecord), as a layout check
+  int32_t timecnt;
+  int32_t typecnt;
+  int32_t charcnt;
+  int32_t speclen;
+  int32_t default_transition_type;
+  int32_t extended;
+  uint8_t rule_type_index[2];
+  int32_t rule_prev_utc_offset[2];
+  PosixTransition rule_pt[2];
+  int64_t first_year;
+  int64_t last_year;
+  Transition future_last;
+  uint64_t unix_time;       // int64_t[timecnt]
+  uint64_t type_index;      // uint8_t[timecnt]
+  uint64_t date_time;       // int64_t[timecnt]
+  uint64_t prev_date_time;  // int64_t[timecnt]
+  uint64_t types;           // TransitionType[typecnt]
+  uint64_t abbrs;           // char[charcnt]
+  uint64_t spec;            // char[speclen]
+};
+
+// Appends len bytes to *bundle, at an offset aligned for any of the
+// tables, and returns that offset.
+uint64_t AppendAligned(std::string* bundle, const void* data, size_t len) {
+  bundle->resize((bundle->size() + 7) & ~static_cast<size_t>(7), '\0');
+  const uint64_t offset = bundle->size();
+  if (len != 0) bundle->append(static_cast<const char*>(data), len);
+  return offset;
+}
+
+// Returns the count elements of T at offset within [base ... base + size),
+// or nullptr if they do not all lie within it, suitably aligned.
+template <typename T>
+const T* BundleArray(const char* base, size_t size, uint64_t offset,
+                     int32_t count) {
+  if (count < 0 || offset > size || offset % alignof(T) != 0) return nullptr;
+  if ((size - offset) / sizeof(T) < static_cast<size_t>(count)) return nullptr;
+  return reinterpret_cast<const T*>(base + offset);
+}
+
+}  // namespace
+
+uint64_t TimeZoneInfo::AppendBundleRecord(std::string* bundle) const {
+  BundleRecord rec;
+  std::memset(&rec, 0, sizeof rec);  // no uninitialized padding
+  rec.record_size = sizeof rec;
+  rec.timecnt = transitions_.size();
+  rec.typecnt = static_cast<int32_t>(type_storage_.size());
+  rec.charcnt = static_cast<int32_t>(abbr_storage_.size());
+  rec.speclen = static_cast<int32_t>(future_spec_.size());
+  rec.default_transition_type = default_transition_type_;
+  rec.extended = extended_;
+  if (extended_) {
+    for (int i = 0; i != 2; ++i) {
+      rec.rule_type_index[i] = future_rules_[i].type_index;
+      rec.rule_prev_utc_offset[i] = future_rules_[i].prev_utc_offset;
+      // Copied by field, so as to leave any padding zeroed.
+      rec.rule_pt[i].month = future_rules_[i].pt.month;
+      rec.rule_pt[i].week = future_rules_[i].pt.week;
+      rec.rule_pt[i].weekday = future_rules_[i].pt.weekday;
+      rec.rule_pt[i].offset = future_rules_[i].pt.offset;
     }
-  } else {
-    if (tt.utc_offset < 0 && seconds < INT64_MIN - tt.utc_offset) {
-      seconds += kSecPer400Years;
-      bd.year -= 400;
+    rec.first_year = first_year_;
+    rec.last_year = last_year_;
+    rec.future_last.unix_time = future_last_.unix_time;
+    rec.future_last.type_index = future_last_.type_index;
+    rec.future_last.date_time = future_last_.date_time;
+    rec.future_last.prev_date_time = future_last_.prev_date_time;
+  }
+  const uint64_t offset = AppendAligned(bundle, &rec, sizeof rec);
+  const size_t n = rec.timecnt;
+  rec.unix_time = AppendAligned(bundle, transitions_.unix_time, 8 * n);
+  rec.type_index = AppendAligned(bundle, transitions_.type_index, n);
+  rec.date_time = AppendAligned(bundle, transitions_.date_time, 8 * n);
+  rec.prev_date_time =
+      AppendAligned(bundle, transitions_.prev_date_time, 8 * n);
+  std::vector<TransitionType> types(rec.typecnt);
+  std::memset(types.data(), 0, sizeof(TransitionType) * rec.typecnt);
+  for (int32_t i = 0; i != rec.typecnt; ++i) {
+    types[i].utc_offset = transition_types_[i].utc_offset;
+    types[i].is_dst = transition_types_[i].is_dst;
+    types[i].abbr_index = transition_types_[i].abbr_index;
+  }
+  rec.types = AppendAligned(bundle, types.data(),
+                            sizeof(TransitionType) * rec.typecnt);
+  rec.abbrs = AppendAligned(bundle, abbreviations_, rec.charcnt);
+  rec.spec = AppendAligned(bundle, future_spec_.data(), rec.speclen);
+  std::memcpy(&(*bundle)[offset], &rec, sizeof rec);  // with the offsets
+  return offset;
+}
+
+bool TimeZoneInfo::LoadBundleRecord(const char* base, size_t size,
+                                    uint64_t offset) {
+  const BundleRecord* rec = BundleArray<BundleRecord>(base, size, offset, 1);
+  if (rec == nullptr || rec->record_size != sizeof(BundleRecord)) return false;
+  const int32_t timecnt = rec->timecnt;
+  const int32_t typecnt = rec->typecnt;
+  const int32_t charcnt = rec->charcnt;
+  Transitions tr;
+  tr.unix_time = BundleArray<int64_t>(base, size, rec->unix_time, timecnt);
+  tr.type_index = BundleArray<uint8_t>(base, size, rec->type_index, timecnt);
+  tr.date_time = BundleArray<int64_t>(base, size, rec->date_time, timecnt);
+  tr.prev_date_time =
+      BundleArray<int64_t>(base, size, rec->prev_date_time, timecnt);
+  tr.count = timecnt;
+  const TransitionType* types =
+      BundleArray<TransitionType>(base, size, rec->types, typecnt);
+  const char* abbrs = BundleArray<char>(base, size, rec->abbrs, charcnt);
+  const char* spec = BundleArray<char>(base, size, rec->spec, rec->speclen);
+  if (tr.unix_time == nullptr || tr.type_index == nullptr ||
+      tr.date_time == nullptr || tr.prev_date_time == nullptr ||
+      types == nullptr || abbrs == nullptr || spec == nullptr)
+    return false;
+
+  // The tables are used as they are, so just check that every index into
+  // them is in range, and that the abbreviations are all terminated.
+  if (typecnt == 0 || charcnt == 0 || abbrs[charcnt - 1]) return false;
+  for (int32_t i = 0; i != timecnt; ++i) {
+    if (tr.type_index[i] >= typecnt)
+      return false;
+  }
+  for (int32_t i = 0; i != typecnt; ++i) {
+    if (types[i].abbr_index >= charcnt)
+      return false;
+  }
+  if (rec->default_transition_type < 0 ||
+      rec->default_transition_type >= typecnt)
+    return false;
+  if (rec->extended) {
+    for (int i = 0; i != 2; ++i) {
+      if (rec->rule_type_index[i] >= typecnt)
+        return false;
     }
   }
-  seconds += tt.utc_offset;
-
-  // Handle years in chunks of 400/100/4/1.
-  bd.year += 400 * (seconds / kSecPer400Years);
-  seconds %= kSecPer400Years;
-  if (seconds < 0) {
-    seconds += kSecPer400Years;
-    bd.year -= 400;
-  }
-  bool leap_year = true;  // 4-century aligned
-  int64_t sec_per_100years = kSecPer100Years[leap_year];
-  while (seconds >= sec_per_100years) {
-    seconds -= sec_per_100years;
-    bd.year += 100;
-    bd.weekday += 5 + leap_year;
-    leap_year = false;  // 1-century, non 4-century aligned
-    sec_per_100years = kSecPer100Years[leap_year];
-  }
-  int32_t sec_per_4years = kSecPer4Years[leap_year];
-  while (seconds >= sec_per_4years) {
-    seconds -= sec_per_4years;
-    bd.year += 4;
-    bd.weekday += 4 + leap_year;
-    leap_year = true;  // 4-year, non century aligned
-    sec_per_4years = kSecPer4Years[leap_year];
-  }
-  int32_t sec_per_year = kSecPerYear[leap_year];
-  while (seconds >= sec_per_year) {
-    seconds -= sec_per_year;
-    bd.year += 1;
-    bd.weekday += 1 + leap_year;
-    leap_year = false;  // non 4-year aligned
-    sec_per_year = kSecPerYear[leap_year];
-  }
-
-  // Handle months and days.
-  bd.yearday = (seconds / SECSPERDAY) + 1;
-  seconds %= SECSPERDAY;
-  bd.month = TM_DECEMBER + 1;
-  bd.day = bd.yearday;
-  bd.weekday += bd.day - 1;
-  while (bd.month != TM_JANUARY + 1) {
-    int month_offset = kMonthOffsets[leap_year][bd.month];
-    if (bd.day > month_offset) {
-      bd.day -= month_offset;
-      break;
+
+  // The lookups, and the indexes built over them, depend on the same
+  // ordering that Load() checks, so hold the record to it too: both key
+  // arrays strictly increasing, and any future rules following on.
+  for (int32_t i = 1; i < timecnt; ++i) {
+    if (!(tr.unix_time[i - 1] < tr.unix_time[i]) ||
+        !(tr.date_time[i - 1] < tr.date_time[i]))
+      return false;  // out of order
+  }
+  if (rec->extended) {
+    if (timecnt == 0 ||
+        !(tr.unix_time[timecnt - 1] < rec->future_last.unix_time) ||
+        !(tr.date_time[timecnt - 1] < rec->future_last.date_time))
+      return false;  // out of order
+  }
+
+  transitions_ = tr;
+  transition_types_ = types;
+  abbreviations_ = abbrs;
+  default_transition_type_ = rec->default_transition_type;
+  future_spec_.assign(spec, rec->speclen);
+  extended_ = (rec->extended != 0);
+  if (extended_) {
+    for (int i = 0; i != 2; ++i) {
+      future_rules_[i].pt = rec->rule_pt[i];
+      future_rules_[i].type_index = rec->rule_type_index[i];
+      future_rules_[i].prev_utc_offset = rec->rule_prev_utc_offset[i];
     }
-    bd.month -= 1;
+    first_year_ = rec->first_year;
+    last_year_ = rec->last_year;
+    future_last_ = rec->future_last;
   }
+  BuildIndexes();
+  return true;
+}
+
+Transition TimeZoneInfo::GetTransition(int32_t i) const {
+  Transition tr;
+  const int32_t timecnt = transitions_.size();
+  if (i < timecnt) {
+    tr.unix_time = transitions_.unix_time[i];
+    tr.type_index = transitions_.type_index[i];
+    tr.date_time = transitions_.date_time[i];
+    tr.prev_date_time = transitions_.prev_date_time[i];
+  } else {
+    const int32_t n = i - timecnt;
+    const FutureRule& rule = future_rules_[n % 2];
+    const int64_t year = first_year_ + 1 + n / 2;
+    const int64_t jan1_ord = DayOrdinal(year, 1, 1);
+    int jan1_weekday = (EPOCH_WDAY + jan1_ord) % DAYSPERWEEK;
+    if (jan1_weekday < 0) jan1_weekday += DAYSPERWEEK;
+    const int64_t offset = TransOffset(IsLeap(year), jan1_weekday, rule.pt);
+    tr.unix_time = jan1_ord * SECSPERDAY + offset - rule.prev_utc_offset;
+    tr.type_index = rule.type_index;
+    tr.date_time =
+        tr.unix_time + transition_types_[rule.type_index].utc_offset;
+    tr.prev_date_time = tr.unix_time + rule.prev_utc_offset - 1;
+  }
+  return tr;
+}
+
+int32_t TimeZoneInfo::FutureIndex(int64_t key, bool local) const {
+  // Each generated transition is within days of the start of its year, so
+  // we need only search back from the year after the (approximate) year of
+  // key, which is usually just a few steps.
+  const int32_t timecnt = transitions_.size();
+  int64_t year = EPOCH_YEAR + key / (kSecPer400Years / 400) + 2;
+  year = std::max(std::min(year, last_year_), first_year_);
+  for (int32_t n = static_cast<int32_t>(year - first_year_) * 2 - 1;
+       n >= 0; --n) {
+    const Transition tr = GetTransition(timecnt + n);
+    if (!(key < (local ? tr.date_time : tr.unix_time))) return timecnt + n;
+  }
+  return timecnt - 1;
+}
+
+// BreakTime() translation for a particular transition type.
+BreakdownLite TimeZoneInfo::LocalTime(int64_t unix_time,
+                                      const TransitionType& tt) const {
+  BreakdownLite bd;
+
+  // A civil time in "+offset" looks like (time+offset) in UTC.
+  int64_t days;
+  int seconds;
+  SplitLocalTime(unix_time, tt.utc_offset, &days, &seconds);
+
+  // Handle years, months, and days.
+  const CivilDate cd = CivilFromDays(days);
+  bd.year = cd.year;
+  bd.month = cd.month;
+  bd.day = cd.day;
+  bd.weekday = cd.weekday;
+  bd.yearday = cd.yearday;
 
   // Handle hours, minutes, and seconds.
   bd.hour = seconds / SECSPERHOUR;
-  seconds %= SECSPERHOUR;
-  bd.minute = seconds / SECSPERMIN;
+  bd.minute = seconds / SECSPERMIN % MINSPERHOUR;
   bd.second = seconds % SECSPERMIN;
-  bd.subsecond = subsecond;
-
-  // Shift weekday to [1==Mon, ..., 7=Sun].
-  bd.weekday -= 1;
-  bd.weekday %= DAYSPERWEEK;
-  bd.weekday += 1;
+  bd.subsecond = duration::zero();
 
   // Handle offset, is_dst, and abbreviation.
   bd.offset = tt.utc_offset;
@@ -772,58 +957,241 @@ TimeInfo TimeZoneInfo::TimeLocal(int64_t year, int mon, int day, int hour,
   return ti;
 }
 
-Breakdown TimeZoneInfo::BreakTime(const time_point& tp) const {
-  int64_t unix_time = ToUnixSeconds(tp);
-  duration subsecond = tp - FromUnixSeconds(unix_time);
-  if (subsecond < duration::zero()) {
-    unix_time -= 1;
-    subsecond += std::chrono::seconds(1);
+BreakdownLite TimeZoneInfo::BreakTime(int64_t unix_time) const {
+  int64_t begin, end;
+  const int type_index = SegmentOf(unix_time, &begin, &end);
+  return LocalTime(unix_time, transition_types_[type_index]);
+}
+
+int64_t TimeZoneInfo::StartOfSpan(int64_t unix_time, int64_t span) const {
+  int64_t begin, end;
+  const int type_index = SegmentOf(unix_time, &begin, &end);
+  const int32_t offset = transition_types_[type_index].utc_offset;
+  const int64_t r = SecondsIntoSpan(unix_time, offset, span);
+  if (begin == INT64_MIN) {
+    // There is no earlier offset.
+    if (unix_time >= INT64_MIN + r) return unix_time - r;
+  } else if (unix_time - r - begin >= kMaxOffsetChange) {
+    return unix_time - r;
   }
+  return TimeZoneIf::StartOfSpan(unix_time, span);  // near a transition
+}
 
+int32_t TimeZoneInfo::TransitionAtOrBefore(int64_t unix_time) const {
   const int32_t timecnt = transitions_.size();
-  if (timecnt == 0 || unix_time < transitions_[0].unix_time) {
-    const int type_index = default_transition_type_;
-    return LocalTime(unix_time, subsecond, transition_types_[type_index]);
+  const int64_t* const unix_times = transitions_.unix_time;
+  if (timecnt == 0 || unix_time < unix_times[0]) return -1;
+  if (unix_time >= unix_times[timecnt - 1]) {
+    return extended_ ? FutureIndex(unix_time, false) : timecnt - 1;
   }
-  if (unix_time >= transitions_[timecnt - 1].unix_time) {
-    // After the last transition. If we extended the transitions using
-    // future_spec_, shift back to a supported year using the 400-year
-    // cycle of calendaric equivalence and then compensate accordingly.
-    if (extended_) {
-      const int64_t diff = unix_time - transitions_[timecnt - 1].unix_time;
-      const int64_t shift = diff / kSecPer400Years + 1;
-      const duration d = std::chrono::seconds(shift * kSecPer400Years);
-      Breakdown bd = BreakTime(tp - d);
-      bd.year += shift * 400;
-      return bd;
+  int32_t lo, hi;
+  unix_time_index_.Range(unix_time, &lo, &hi);
+  return static_cast<int32_t>(
+      std::upper_bound(unix_times + lo, unix_times + hi, unix_time) -
+      unix_times) - 1;
+}
+
+bool TimeZoneInfo::ChangesType(uint8_t prev_index, uint8_t index) const {
+  if (prev_index == index) return false;
+  const TransitionType& prev = transition_types_[prev_index];
+  const TransitionType& tt = transition_types_[index];
+  return prev.utc_offset != tt.utc_offset || prev.is_dst != tt.is_dst ||
+         std::strcmp(&abbreviations_[prev.abbr_index],
+                     &abbreviations_[tt.abbr_index]) != 0;
+}
+
+bool TimeZoneInfo::NextTransition(int64_t unix_time, int64_t* trans) const {
+  if (extended_ && unix_time >= future_last_.unix_time) {
+    // Beyond the generated transitions, shift back by whole 400-year
+    // cycles, which repeat the transitions exactly.
+    const int64_t shift =
+        ((unix_time - future_last_.unix_time) / kSecPer400Years + 1) *
+        kSecPer400Years;
+    Count(kFutureShifts);
+    int64_t shifted;
+    if (!NextTransition(unix_time - shift, &shifted)) return false;
+    if (shifted > std::numeric_limits<int64_t>::max() - shift) return false;
+    *trans = shifted + shift;
+    return true;
+  }
+  const int32_t count =
+      transitions_.size() + (extended_ ? kFutureYears * 2 : 0);
+  const int32_t i = TransitionAtOrBefore(unix_time);
+  uint8_t prev_index = (i < 0) ? default_transition_type_
+                               : GetTransition(i).type_index;
+  for (int32_t j = i + 1; j < count; ++j) {
+    const Transition tr = GetTransition(j);
+    if (tr.unix_time != kBigBang && ChangesType(prev_index, tr.type_index)) {
+      *trans = tr.unix_time;
+      return true;
+    }
+    prev_index = tr.type_index;
+  }
+  return false;
+}
+
+bool TimeZoneInfo::PrevTransition(int64_t unix_time, int64_t* trans) const {
+  if (unix_time == std::numeric_limits<int64_t>::min()) return false;
+  int32_t i;
+  if (!extended_ || unix_time <= future_last_.unix_time) {
+    i = TransitionAtOrBefore(unix_time - 1);
+  } else {
+    // As above, but shifting to at or before the last generated transition.
+    const int64_t shift =
+        ((unix_time - 1 - future_last_.unix_time) / kSecPer400Years + 1) *
+        kSecPer400Years;
+    Count(kFutureShifts);
+    int64_t shifted;
+    const Transition first_generated = GetTransition(transitions_.size());
+    if (PrevTransition(unix_time - shift, &shifted) &&
+        shifted >= first_generated.unix_time) {
+      *trans = shifted + shift;
+      return true;
+    }
+    // Only the generated transitions repeat, so otherwise the answer is
+    // the last change at or before them.
+    i = transitions_.size() + kFutureYears * 2 - 1;
+  }
+  for (int32_t j = i; j >= 0; --j) {
+    const Transition tr = GetTransition(j);
+    const uint8_t prev_index = (j == 0) ? default_transition_type_
+                                        : GetTransition(j - 1).type_index;
+    if (tr.unix_time != kBigBang && ChangesType(prev_index, tr.type_index)) {
+      *trans = tr.unix_time;
+      return true;
     }
-    const int type_index = transitions_[timecnt - 1].type_index;
-    return LocalTime(unix_time, subsecond, transition_types_[type_index]);
   }
+  return false;
+}
 
-  const int32_t hint = local_time_hint_.load(std::memory_order_relaxed);
-  if (0 < hint && hint < timecnt) {
-    if (unix_time < transitions_[hint].unix_time) {
-      if (!(unix_time < transitions_[hint - 1].unix_time)) {
-        const int type_index = transitions_[hint - 1].type_index;
-        return LocalTime(unix_time, subsecond, transition_types_[type_index]);
+void TimeZoneInfo::BreakTimes(const int64_t* unix_seconds, std::size_t n,
+                              const BreakdownColumns& out) const {
+  int64_t begin = 0;  // the span of times over which type_index applies,
+  int64_t end = 0;    // initially empty
+  int type_index = default_transition_type_;
+  uint8_t types[kBlockSize];
+  int64_t year[kBlockSize];
+  int month[kBlockSize], day[kBlockSize];
+  int hour[kBlockSize], minute[kBlockSize], second[kBlockSize];
+  int weekday[kBlockSize], yearday[kBlockSize];
+  int64_t days[kBlockSize];
+  int sod[kBlockSize];
+  const bool want_date = out.year != nullptr || out.month != nullptr ||
+                         out.day != nullptr || out.weekday != nullptr ||
+                         out.yearday != nullptr;
+  const bool want_time = out.hour != nullptr || out.minute != nullptr ||
+                         out.second != nullptr;
+  for (std::size_t base = 0; base < n; base += kBlockSize) {
+    const int64_t* const times = unix_seconds + base;
+    const std::size_t m = std::min(kBlockSize, n - base);
+
+    // Find the type of each time, only searching the transitions when a
+    // time falls outside the span of the previous one.
+    std::size_t searches = 0;
+    for (std::size_t i = 0; i != m; ++i) {
+      if (times[i] < begin || !(times[i] < end)) {
+        type_index = SegmentOf(times[i], &begin, &end);
+        ++searches;
+      }
+      types[i] = static_cast<uint8_t>(type_index);
+    }
+    Count(kBreakTimesSearches, searches);
+    for (std::size_t i = 0; i != m; ++i) {
+      const TransitionType& tt = transition_types_[types[i]];
+      if (out.offset != nullptr) out.offset[base + i] = tt.utc_offset;
+      if (out.is_dst != nullptr) out.is_dst[base + i] = tt.is_dst;
+      if (out.abbr != nullptr) {
+        out.abbr[base + i] = &abbreviations_[tt.abbr_index];
+      }
+    }
+
+    // Compute the civil-time fields, skipping the date or the time of day
+    // when none of its columns are wanted. These loops have no
+    // data-dependent branches or table lookups (excepting the offsets),
+    // so the compiler is free to vectorize them.
+    for (std::size_t i = 0; i != m; ++i) {
+      SplitLocalTime(times[i], transition_types_[types[i]].utc_offset,
+                     &days[i], &sod[i]);
+    }
+    if (want_date) {
+      for (std::size_t i = 0; i != m; ++i) {
+        const CivilDate cd = CivilFromDays(days[i]);
+        year[i] = cd.year;
+        month[i] = cd.month;
+        day[i] = cd.day;
+        weekday[i] = cd.weekday;
+        yearday[i] = cd.yearday;
       }
+      CopyColumn(year, m, out.year == nullptr ? nullptr : out.year + base);
+      CopyColumn(month, m, out.month == nullptr ? nullptr : out.month + base);
+      CopyColumn(day, m, out.day == nullptr ? nullptr : out.day + base);
+      CopyColumn(weekday, m,
+                 out.weekday == nullptr ? nullptr : out.weekday + base);
+      CopyColumn(yearday, m,
+                 out.yearday == nullptr ? nullptr : out.yearday + base);
+    }
+    if (want_time) {
+      for (std::size_t i = 0; i != m; ++i) {
+        hour[i] = sod[i] / SECSPERHOUR;
+        minute[i] = sod[i] / SECSPERMIN % MINSPERHOUR;
+        second[i] = sod[i] % SECSPERMIN;
+      }
+      CopyColumn(hour, m, out.hour == nullptr ? nullptr : out.hour + base);
+      CopyColumn(minute, m,
+                 out.minute == nullptr ? nullptr : out.minute + base);
+      CopyColumn(second, m,
+                 out.second == nullptr ? nullptr : out.second + base);
     }
   }
+}
 
-  const Transition target = {unix_time};
-  const Transition* begin = &transitions_[0];
-  const Transition* tr = std::upper_bound(begin, begin + timecnt, target,
-                                          Transition::ByUnixTime());
-  local_time_hint_.store(tr - begin, std::memory_order_relaxed);
-  const int type_index = (--tr)->type_index;
-  return LocalTime(unix_time, subsecond, transition_types_[type_index]);
+int TimeZoneInfo::SegmentOf(int64_t unix_time,
+                            int64_t* begin, int64_t* end) const {
+  const int32_t timecnt = transitions_.size();
+  const int64_t* const unix_times = transitions_.unix_time;
+  if (timecnt == 0 || unix_time < unix_times[0]) {
+    *begin = INT64_MIN;
+    *end = (timecnt == 0) ? INT64_MAX : unix_times[0];
+    return default_transition_type_;
+  }
+  if (unix_time >= unix_times[timecnt - 1]) {
+    // After the last transition. If we extended the transitions using
+    // future_spec_, shift back to a supported year using the 400-year
+    // cycle of calendaric equivalence, which preserves the type.
+    if (extended_) {
+      if (unix_time < future_last_.unix_time) {
+        const int32_t i = FutureIndex(unix_time, false);
+        const Transition tr = GetTransition(i);
+        *begin = tr.unix_time;
+        *end = GetTransition(i + 1).unix_time;
+        return tr.type_index;
+      }
+      const int64_t diff = unix_time - future_last_.unix_time;
+      const int64_t shift = diff / kSecPer400Years + 1;
+      Count(kFutureShifts);
+      int64_t shifted_begin, shifted_end;
+      *begin = *end = unix_time;  // not worth shifting back
+      return SegmentOf(unix_time - shift * kSecPer400Years,
+                       &shifted_begin, &shifted_end);
+    }
+    *begin = unix_times[timecnt - 1];
+    *end = INT64_MAX;
+    return transitions_.type_index[timecnt - 1];
+  }
+
+  int32_t lo, hi;
+  unix_time_index_.Range(unix_time, &lo, &hi);
+  const int32_t i = static_cast<int32_t>(
+      std::upper_bound(unix_times + lo, unix_times + hi, unix_time) -
+      unix_times) - 1;
+  *begin = unix_times[i];
+  *end = unix_times[i + 1];
+  return transitions_.type_index[i];
 }
 
 TimeInfo TimeZoneInfo::MakeTimeInfo(int64_t year, int mon, int day,
                                     int hour, int min, int sec) const {
-  Transition target;
-  DateTime& dt(target.date_time);
+  DateTime dt;
   const bool normalized = dt.Normalize(year, mon, day, hour, min, sec);
 
   const int32_t timecnt = transitions_.size();
@@ -835,69 +1203,156 @@ TimeInfo TimeZoneInfo::MakeTimeInfo(int64_t year, int mon, int day,
   }
 
   // Find the first transition after our target date/time.
-  const Transition* tr = nullptr;
-  const Transition* begin = &transitions_[0];
-  const Transition* end = begin + timecnt;
-  if (dt < begin->date_time) {
-    tr = begin;
-  } else if (!(dt < transitions_[timecnt - 1].date_time)) {
-    tr = end;
+  const int32_t count = timecnt + (extended_ ? kFutureYears * 2 : 0);
+  const int64_t* const date_times = transitions_.date_time;
+  int32_t i;
+  if (dt.offset < date_times[0]) {
+    i = 0;
+  } else if (dt.offset < date_times[timecnt - 1]) {
+    // As dt lies between the first and last transitions, it fits in 64 bits.
+    const int64_t key = static_cast<int64_t>(dt.offset);
+    int32_t lo, hi;
+    date_time_index_.Range(key, &lo, &hi);
+    i = std::upper_bound(date_times + lo, date_times + hi, key) - date_times;
+  } else if (extended_ && dt.offset < future_last_.date_time) {
+    i = FutureIndex(static_cast<int64_t>(dt.offset), true) + 1;
   } else {
-    const int32_t hint = time_local_hint_.load(std::memory_order_relaxed);
-    if (0 < hint && hint < timecnt) {
-      if (dt < transitions_[hint].date_time) {
-        if (!(dt < transitions_[hint - 1].date_time)) {
-          tr = begin + hint;
-        }
-      }
-    }
-    if (tr == nullptr) {
-      tr = std::upper_bound(begin, end, target, Transition::ByDateTime());
-      time_local_hint_.store(tr - begin, std::memory_order_relaxed);
-    }
+    i = count;
   }
 
-  if (tr == begin) {
-    if (!(tr->prev_date_time < dt)) {
+  if (i == 0) {
+    const Transition tr = GetTransition(i);
+    if (!(tr.prev_date_time < dt.offset)) {
       // Before first transition, so use the default offset.
       int offset = transition_types_[default_transition_type_].utc_offset;
       __int128 unix_time = (dt - DateTime{0}) - offset;
       return MakeUnique(unix_time, normalized);
     }
-    // tr->prev_date_time < dt < tr->date_time
-    return MakeSkipped(*tr, dt, normalized);
+    // tr.prev_date_time < dt < tr.date_time
+    return MakeSkipped(tr, dt, normalized);
   }
 
-  if (tr == end) {
-    if ((--tr)->prev_date_time < dt) {
+  if (i == count) {
+    const Transition tr = GetTransition(i - 1);
+    if (tr.prev_date_time < dt.offset) {
       // After the last transition. If we extended the transitions using
       // future_spec_, shift back to a supported year using the 400-year
       // cycle of calendaric equivalence and then compensate accordingly.
       if (extended_ && year > last_year_) {
         const int64_t shift = (year - last_year_) / 400 + 1;
+        Count(kFutureShifts);
         return TimeLocal(year - shift * 400, mon, day, hour, min, sec,
                          static_cast<__int128>(shift) * kSecPer400Years);
       }
-      __int128 unix_time = tr->unix_time + (dt - tr->date_time);
+      __int128 unix_time = tr.unix_time + (dt.offset - tr.date_time);
       return MakeUnique(unix_time, normalized);
     }
-    // tr->date_time <= dt <= tr->prev_date_time
-    return MakeRepeated(*tr, dt, normalized);
+    // tr.date_time <= dt <= tr.prev_date_time
+    return MakeRepeated(tr, dt, normalized);
   }
 
-  if (tr->prev_date_time < dt) {
-    // tr->prev_date_time < dt < tr->date_time
-    return MakeSkipped(*tr, dt, normalized);
+  const Transition tr = GetTransition(i);
+  if (tr.prev_date_time < dt.offset) {
+    // tr.prev_date_time < dt < tr.date_time
+    return MakeSkipped(tr, dt, normalized);
   }
 
-  if (!((--tr)->prev_date_time < dt)) {
-    // tr->date_time <= dt <= tr->prev_date_time
-    return MakeRepeated(*tr, dt, normalized);
+  const Transition prev = GetTransition(i - 1);
+  if (!(prev.prev_date_time < dt.offset)) {
+    // prev.date_time <= dt <= prev.prev_date_time
+    return MakeRepeated(prev, dt, normalized);
   }
 
   // In between transitions.
-  __int128 unix_time = tr->unix_time + (dt - tr->date_time);
+  __int128 unix_time = prev.unix_time + (dt.offset - prev.date_time);
   return MakeUnique(unix_time, normalized);
 }
 
+void TimeZoneInfo::MakeTimes(const CivilColumns& civil, std::size_t n,
+                             int64_t* unix_seconds,
+                             TimeInfo::Kind* kinds) const {
+  int64_t begin = 0;  // the span of local date/times that is converted
+  int64_t end = 0;    // uniquely using utc_offset, initially empty
+  int32_t utc_offset = 0;
+  std::size_t searches = 0;
+  std::size_t fallbacks = 0;
+  for (std::size_t i = 0; i != n; ++i) {
+    const int64_t year = civil.year[i];
+    const int mon = civil.month[i];
+    const int day = civil.day[i];
+    const int hour = (civil.hour != nullptr) ? civil.hour[i] : 0;
+    const int min = (civil.minute != nullptr) ? civil.minute[i] : 0;
+    const int sec = (civil.second != nullptr) ? civil.second[i] : 0;
+
+    // Rows with in-range fields (the usual case) need no normalization, and
+    // a unique local date/time needs only its UTC offset.
+    if (-kMaxFastYear <= year && year <= kMaxFastYear &&
+        1 <= mon && mon <= MONSPERYEAR &&
+        1 <= day && day <= kDaysPerMonth[IsLeap(year)][mon] &&
+        0 <= hour && hour < HOURSPERDAY &&
+        0 <= min && min < MINSPERHOUR &&
+        0 <= sec && sec < SECSPERMIN) {
+      const int64_t date_time = DayOrdinal(year, mon, day) * SECSPERDAY +
+                                hour * SECSPERHOUR + min * SECSPERMIN + sec;
+      bool unique = (begin <= date_time && date_time < end);
+      if (!unique) {
+        unique = LocalSegmentOf(date_time, &utc_offset, &begin, &end);
+        ++searches;
+      }
+      if (unique) {
+        unix_seconds[i] = date_time - utc_offset;
+        if (kinds != nullptr) kinds[i] = TimeInfo::Kind::UNIQUE;
+        continue;
+      }
+    }
+
+    // Otherwise fall back to the full conversion.
+    MakeTimeRow(*this, civil, i, unix_seconds, kinds);
+    ++fallbacks;
+  }
+  Count(kMakeTimesSearches, searches);
+  Count(kMakeTimesFallbacks, fallbacks);
+}
+
+bool TimeZoneInfo::LocalSegmentOf(int64_t date_time, int32_t* utc_offset,
+                                  int64_t* begin, int64_t* end) const {
+  const int32_t timecnt = transitions_.size();
+  const int64_t* const date_times = transitions_.date_time;
+  const int64_t* const prev_date_times = transitions_.prev_date_time;
+
+  // Find the first transition after the target date/time.
+  int32_t i;
+  if (timecnt == 0 || date_time < date_times[0]) {
+    i = 0;
+  } else if (date_time < date_times[timecnt - 1]) {
+    int32_t lo, hi;
+    date_time_index_.Range(date_time, &lo, &hi);
+    i = static_cast<int32_t>(std::upper_bound(date_times + lo,
+                                              date_times + hi, date_time) -
+                             date_times);
+  } else if (extended_) {
+    return false;  // in the generated transitions
+  } else {
+    i = timecnt;
+  }
+
+  // The conversion is unique after any repeated date/times of the previous
+  // transition, and before any skipped ones of the next.
+  int64_t lo = INT64_MIN;
+  int64_t hi = INT64_MAX;
+  int32_t offset = transition_types_[default_transition_type_].utc_offset;
+  if (i != 0) {
+    lo = std::max(date_times[i - 1], prev_date_times[i - 1] + 1);
+    offset = transition_types_[transitions_.type_index[i - 1]].utc_offset;
+  }
+  if (i != timecnt) {
+    hi = std::min(date_times[i], prev_date_times[i] + 1);
+  }
+  if (date_time < lo || !(date_time < hi)) return false;
+  *utc_offset = offset;
+  *begin = lo;
+  *end = hi;
+  return true;
+}
+
 }  // namespace cctz
@@ -16,13 +16,13 @@
 #ifndef CCTZ_INFO_H_
 #define CCTZ_INFO_H_
 
-#include <atomic>
+#include <cstddef>
 #include <cstdint>
-#include <cstdio>
 #include <string>
 #include <vector>
 
 #include "src/cctz_if.h"
+#include "src/cctz_posix.h"
 #include "src/tzfile.h"
 
 namespace cctz {
@@ -45,7 +45,6 @@ namespace cctz {
 struct DateTime {
   __int128 offset;  // seconds from some epoch DateTime
   bool Normalize(int64_t year, int mon, int day, int hour, int min, int sec);
-  void Assign(const Breakdown& bd);
 };
 
 inline bool operator<(const DateTime& lhs, const DateTime& rhs) {
@@ -58,23 +57,81 @@ inline __int128 operator-(const DateTime& lhs, const DateTime& rhs) {
   return lhs.offset - rhs.offset;
 }
 
-// A transition to a new UTC offset.
+// The transitions to new UTC offsets, ordered by both unix_time and
+// date_time. They are stored as parallel arrays, rather than as an array
+// of records, so that each search key is dense in memory. The local
+// date/times of a transition are the DateTime offsets (from the epoch
+// 1970-01-01 00:00:00) of the civil time at, and one second before, the
+// transition. TimeZoneInfo only accepts transitions for which these fit
+// in 64 bits, which is true of every real zone by a wide margin. The
+// arrays are either those of a TransitionStorage, or they live in place
+// within a mapped zone bundle (see cctz_bundle.h).
+struct Transitions {
+  const int64_t* unix_time = nullptr;       // the instant of each transition
+  const uint8_t* type_index = nullptr;      // index of the transition type
+  const int64_t* date_time = nullptr;       // local date/time of transition
+  const int64_t* prev_date_time = nullptr;  // local date/time one second ago
+  int32_t count = 0;
+
+  int32_t size() const { return count; }
+};
+
+// Owned storage for the arrays of Transitions.
+struct TransitionStorage {
+  std::vector<int64_t> unix_time;
+  std::vector<uint8_t> type_index;
+  std::vector<int64_t> date_time;
+  std::vector<int64_t> prev_date_time;
+
+  void resize(int32_t n) {
+    unix_time.resize(n);
+    type_index.resize(n);
+    date_time.resize(n);
+    prev_date_time.resize(n);
+  }
+};
+
+// A single transition, either as stored in Transitions or as generated
+// on demand from the future specification.
 struct Transition {
-  int64_t unix_time;        // the instant of this transition
-  uint8_t type_index;       // index of the transition type
-  DateTime date_time;       // local date/time of transition
-  DateTime prev_date_time;  // local date/time one second earlier
-
-  struct ByUnixTime {
-    inline bool operator()(const Transition& lhs, const Transition& rhs) const {
-      return lhs.unix_time < rhs.unix_time;
-    }
-  };
-  struct ByDateTime {
-    inline bool operator()(const Transition& lhs, const Transition& rhs) const {
-      return lhs.date_time < rhs.date_time;
+  int64_t unix_time;       // the instant of this transition
+  uint8_t type_index;      // index of the transition type
+  int64_t date_time;       // local date/time of transition
+  int64_t prev_date_time;  // local date/time one second earlier
+};
+
+// A bucketed index over an increasing sequence of transition keys (either
+// the unix_time or the date_time of each transition), which narrows the
+// search for the first key greater than some target to a table load and
+// at most a few comparisons. Keys are bucketed by ((key - base) >> shift),
+// and each bucket records the upper bound of its smallest possible key, so
+// the upper bound of any key in the bucket lies between its entry and that
+// of the next bucket. The shift is chosen so that there are about twice as
+// many buckets as keys. Any leading keys that would make the index overly
+// sparse (e.g., the zic "BIG_BANG" transition) are left out of it.
+class TransitionIndex {
+ public:
+  // Builds the index over the given count increasing keys.
+  void Build(const int64_t* keys, int32_t count);
+
+  // Sets [*lo, *hi) to the positions between which the upper bound of key
+  // lies. key must be within [keys[0] : keys[count - 1]).
+  void Range(int64_t key, int32_t* lo, int32_t* hi) const {
+    if (key < base_) {
+      *lo = 0;
+      *hi = first_;
+    } else {
+      const uint64_t bucket = static_cast<uint64_t>(key - base_) >> shift_;
+      *lo = buckets_[bucket];
+      *hi = buckets_[bucket + 1];
     }
-  };
+  }
+
+ private:
+  int64_t base_;                  // the smallest indexed key
+  int32_t first_;                 // the position of base_
+  int shift_;                     // log2 of the bucket width
+  std::vector<int32_t> buckets_;  // upper bounds, plus a final sentinel
 };
 
 // The characteristics of a particular transition.
@@ -86,19 +143,47 @@ struct TransitionType {
 
 
 // A time zone backed by the IANA Time Zone Database (zoneinfo).
-class TimeZoneInfo : public TimeZoneIf {
+class TimeZoneInfo final : public TimeZoneIf {
  public:
-  TimeZoneInfo() = default;
+  TimeZoneInfo() : TimeZoneIf(Kind::kInfo) {}
   TimeZoneInfo(const TimeZoneInfo&) = delete;
   TimeZoneInfo& operator=(const TimeZoneInfo&) = delete;
 
   // Loads the zoneinfo for the given name, returning true if successful.
   bool Load(const std::string& name);
 
+  // Loads the zoneinfo for the given name from the local zoneinfo files,
+  // ignoring any zone bundle.
+  bool LoadFile(const std::string& name);
+
+  // Loads the zoneinfo from the size bytes of TZif data at data (e.g., from
+  // a mapped file), which need only remain valid for the duration of the
+  // call. The name is only used in diagnostics.
+  bool Load(const std::string& name, const char* data, std::size_t size);
+
+  // Zone-bundle support (see cctz_bundle.h). AppendBundleRecord() appends
+  // the tables of a zone loaded from zoneinfo to the bundle under
+  // construction, returning the offset of its record. LoadBundleRecord()
+  // adopts the tables of the record at offset from the size bytes of the
+  // bundle at base in place, so they must outlive this object.
+  uint64_t AppendBundleRecord(std::string* bundle) const;
+  bool LoadBundleRecord(const char* base, std::size_t size, uint64_t offset);
+
+  // Returns the names of all the zones in the local zoneinfo tree, other
+  // than those of the "posix" and "right" variants.
+  static std::vector<std::string> ZoneNames();
+
   // TimeZoneIf implementations.
-  Breakdown BreakTime(const time_point& tp) const override;
+  BreakdownLite BreakTime(int64_t unix_time) const override;
+  void BreakTimes(const int64_t* unix_seconds, std::size_t n,
+                  const BreakdownColumns& out) const override;
   TimeInfo MakeTimeInfo(int64_t year, int mon, int day,
                         int hour, int min, int sec) const override;
+  void MakeTimes(const CivilColumns& civil, std::size_t n,
+                 int64_t* unix_seconds, TimeInfo::Kind* kinds) const override;
+  int64_t StartOfSpan(int64_t unix_time, int64_t span) const override;
+  bool NextTransition(int64_t unix_time, int64_t* trans) const override;
+  bool PrevTransition(int64_t unix_time, int64_t* trans) const override;
 
  private:
   struct Header {  // counts of:
@@ -117,26 +202,77 @@ class TimeZoneInfo : public TimeZoneIf {
                        int32_t offset, bool is_dst,
                        const std::string& abbr) const;
 
+  // Loads the named zone from the process-wide zone bundle, if any.
+  // Implemented in cctz_bundle.cc.
+  bool LoadFromBundle(const std::string& name);
+
   void ResetToBuiltinUTC(int seconds);
-  bool Load(const std::string& name, FILE* fp);
+  void BuildIndexes();
+  bool LoadFromDescriptor(const std::string& name, int fd);
+
+  // The transitions generated from future_spec_ for the years after the
+  // last zic transition are computed on demand, rather than stored, as most
+  // of them are never needed. Transition i (of any kind) is GetTransition(i).
+  // FutureIndex() returns the position of the last transition whose unix
+  // time (or local date/time) is not greater than key, where key lies
+  // between the last zic transition and the last generated one.
+  Transition GetTransition(int32_t i) const;
+  int32_t FutureIndex(int64_t key, bool local) const;
+
+  // Returns the index of the transition type in effect at unix_time, and
+  // sets [*begin, *end) to a span of times around it having that type.
+  int SegmentOf(int64_t unix_time, int64_t* begin, int64_t* end) const;
+
+  // Returns the position of the last transition (stored or generated) at
+  // or before unix_time, or -1 if there is none. unix_time must be before
+  // the last generated transition.
+  int32_t TransitionAtOrBefore(int64_t unix_time) const;
+
+  // Returns whether a transition from the type at prev_index to that at
+  // index is visible to callers, rather than just a change of some zic
+  // detail that does not affect conversions (such as the isstd flags).
+  bool ChangesType(uint8_t prev_index, uint8_t index) const;
+
+  // If the local date_time is converted uniquely, sets *utc_offset to the
+  // offset used and [*begin, *end) to a span of local date/times around it
+  // that are likewise converted, and returns true. Otherwise returns false.
+  // Only considers the stored transitions, not those from future_spec_.
+  bool LocalSegmentOf(int64_t date_time, int32_t* utc_offset,
+                      int64_t* begin, int64_t* end) const;
 
   // Helpers for BreakTime() and MakeTimeInfo() respectively.
-  Breakdown LocalTime(int64_t unix_time, duration subsecond,
-                      const TransitionType& tt) const;
+  BreakdownLite LocalTime(int64_t unix_time, const TransitionType& tt) const;
   TimeInfo TimeLocal(int64_t year, int mon, int day,
                      int hour, int min, int sec, __int128 offset) const;
 
-  std::vector<Transition> transitions_;  // ordered by unix_time and date_time
-  std::vector<TransitionType> transition_types_;  // distinct transition types
+  // Points the tables at the owned storage below.
+  void UseStorage();
+
+  Transitions transitions_;          // ordered by unix_time and date_time
+  TransitionIndex unix_time_index_;  // BreakTime() search index
+  TransitionIndex date_time_index_;  // MakeTimeInfo() search index
+  const TransitionType* transition_types_;  // distinct transition types
   int default_transition_type_;  // for before the first transition
-  std::string abbreviations_;  // all the NUL-terminated abbreviations
+  const char* abbreviations_;  // all the NUL-terminated abbreviations
+
+  // The tables of a zone loaded from zoneinfo, rather than from a bundle.
+  TransitionStorage transition_storage_;
+  std::vector<TransitionType> type_storage_;
+  std::string abbr_storage_;
+
+  // One of the two yearly rules from future_spec_.
+  struct FutureRule {
+    PosixTransition pt;       // when in the year the transition happens
+    uint8_t type_index;       // the type of the transition
+    int32_t prev_utc_offset;  // the UTC offset in effect before it
+  };
 
   std::string future_spec_;  // for after the last zic transition
   bool extended_;            // future_spec_ was used to generate transitions
+  FutureRule future_rules_[2];  // the transitions of each year, in order
+  Transition future_last_;   // the final generated transition
+  int64_t first_year_;       // the year of the last zic transition
   int64_t last_year_;        // the final year of the generated transitions
-
-  mutable std::atomic<int32_t> local_time_hint_;  // BreakTime() search hint
-  mutable std::atomic<int32_t> time_local_hint_;  // MakeTimeInfo() search hint
 };
 
 }  // namespace cctz
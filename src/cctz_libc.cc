@@ -15,37 +15,102 @@
 
 #include "src/cctz_libc.h"
 
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
 #include <chrono>
 #include <cstdint>
+#include <cstdlib>
 #include <ctime>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "src/cctz_days.h"
+#include "src/cctz_fixed.h"
+#include "src/cctz_info.h"
 
 namespace cctz {
 
 TimeZoneLibC::TimeZoneLibC(const std::string& name) {
   local_ = (name == "localtime");
   if (!local_) {
-    // TODO: Support "UTC-05:00", for example.
-    offset_ = 0;
-    abbr_ = "UTC";
+    int32_t offset;
+    if (ParseFixedOffset(name, &offset, &abbr_)) {
+      offset_ = offset;
+    } else {
+      offset_ = 0;
+      abbr_ = "UTC";
+    }
   }
 }
 
-Breakdown TimeZoneLibC::BreakTime(const time_point& tp) const {
-  Breakdown bd;
-  std::time_t t = ToUnixSeconds(tp);
-  duration subsecond = tp - FromUnixSeconds(t);
-  if (subsecond < duration::zero()) {
-    t -= 1;
-    subsecond += std::chrono::seconds(1);
+namespace {
+
+// Reads the whole file at path into *data, quietly returning false on any
+// error, as the caller has a fallback.
+bool ReadFile(const std::string& path, std::vector<char>* data) {
+  const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd == -1) return false;
+  char chunk[4096];
+  for (;;) {
+    const ssize_t n = read(fd, chunk, sizeof chunk);
+    if (n == 0) break;
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      close(fd);
+      return false;
+    }
+    data->insert(data->end(), chunk, chunk + n);
   }
+  close(fd);
+  return true;
+}
+
+}  // namespace
+
+std::unique_ptr<TimeZoneIf> TimeZoneLibC::LoadSnapshot() {
+  // Resolve ${TZ} as tzset(3) does: unset means the system default, empty
+  // means UTC, and otherwise it names a file, optionally after a ':', that
+  // is relative to the zoneinfo directory unless it is absolute.
+  std::unique_ptr<TimeZoneInfo> tz(new TimeZoneInfo);
+  const char* name = std::getenv("TZ");
+  std::string path;
+  if (name == nullptr) {
+    const char* localtime = std::getenv("LOCALTIME");
+    path = localtime ? localtime : "/etc/localtime";
+  } else {
+    if (*name == ':') ++name;
+    if (*name == '\0') {
+      tz->Load("UTC");
+      return std::unique_ptr<TimeZoneIf>(tz.release());
+    }
+    if (*name != '/') {
+      const char* tzdir = std::getenv("TZDIR");
+      path = tzdir ? tzdir : "/usr/share/zoneinfo";
+      path += '/';
+    }
+    path += name;
+  }
+  std::vector<char> data;
+  if (ReadFile(path, &data) && tz->Load(path, data.data(), data.size())) {
+    return std::unique_ptr<TimeZoneIf>(tz.release());
+  }
+  return std::unique_ptr<TimeZoneIf>(new TimeZoneLibC("localtime"));
+}
+
+BreakdownLite TimeZoneLibC::BreakTime(int64_t unix_time) const {
+  BreakdownLite bd;
+  const std::time_t t = unix_time;
   std::tm tm;
   if (local_) {
     localtime_r(&t, &tm);
     bd.abbr = tm.tm_zone;
   } else {
-    gmtime_r(&t, &tm);
-    tm.tm_gmtoff += offset_;
-    bd.abbr = abbr_;
+    const std::time_t lt = t + offset_;
+    gmtime_r(&lt, &tm);
+    tm.tm_gmtoff = offset_;
+    bd.abbr = abbr_.c_str();
   }
   bd.year = tm.tm_year + 1900;
   bd.month = tm.tm_mon + 1;
@@ -53,7 +118,7 @@ Breakdown TimeZoneLibC::BreakTime(const time_point& tp) const {
   bd.hour = tm.tm_hour;
   bd.minute = tm.tm_min;
   bd.second = tm.tm_sec;
-  bd.subsecond = subsecond;
+  bd.subsecond = duration::zero();
   bd.weekday = (tm.tm_wday ? tm.tm_wday : 7);
   bd.yearday = tm.tm_yday + 1;
   bd.is_dst = tm.tm_isdst;
@@ -75,30 +140,9 @@ int NormalizeField(int base, int* val, bool* normalized) {
   return carry;
 }
 
-bool IsLeap(int64_t year) {
-  return year % 4 == 0 && (year % 100 != 0 || year % 400 == 0);
-}
-
-// The month lengths in non-leap and leap years respectively.
-const int kDaysPerMonth[2][1+12] = {
-  {-1, 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31},
-  {-1, 31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31},
-};
-
 // The number of days in non-leap and leap years respectively.
 const int kDaysPerYear[2] = {365, 366};
 
-// Map a (normalized) Y/M/D to the number of days before/after 1970-01-01.
-// See http://howardhinnant.github.io/date_algorithms.html#days_from_civil.
-std::time_t DayOrdinal(int64_t year, int month, int day) {
-  year -= (month <= 2 ? 1 : 0);
-  const std::time_t era = (year >= 0 ? year : year - 399) / 400;
-  const int yoe = year - era * 400;
-  const int doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
-  const int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
-  return era * 146097 + doe - 719468;  // shift epoch to 1970-01-01
-}
-
 }  // namespace
 
 TimeInfo TimeZoneLibC::MakeTimeInfo(int64_t year, int mon, int day,
@@ -150,6 +194,7 @@ TimeInfo TimeZoneLibC::MakeTimeInfo(int64_t year, int mon, int day,
       }
     }
     t = ((((DayOrdinal(year, mon, day) * 24) + hour) * 60) + min) * 60 + sec;
+    t -= offset_;
   }
   TimeInfo ti;
   ti.kind = TimeInfo::Kind::UNIQUE;
@@ -16,6 +16,7 @@
 #ifndef CCTZ_LIBC_H_
 #define CCTZ_LIBC_H_
 
+#include <memory>
 #include <string>
 
 #include "src/cctz_if.h"
@@ -28,8 +29,16 @@ class TimeZoneLibC : public TimeZoneIf {
  public:
   explicit TimeZoneLibC(const std::string& name);
 
+  // Returns the local zone as the C library would resolve it now (from
+  // ${TZ}, or else /etc/localtime), decoded once from its zoneinfo file so
+  // that conversions avoid localtime_r(3) and mktime(3), and with them the
+  // global lock they take. Falls back to a TimeZoneLibC("localtime") when
+  // the file cannot be decoded (e.g., when ${TZ} is a bare POSIX spec).
+  // Like any zone, the result only sees later changes on a reload.
+  static std::unique_ptr<TimeZoneIf> LoadSnapshot();
+
   // TimeZoneIf implementations.
-  Breakdown BreakTime(const time_point& tp) const override;
+  BreakdownLite BreakTime(int64_t unix_time) const override;
   TimeInfo MakeTimeInfo(int64_t year, int mon, int day,
                         int hour, int min, int sec) const override;
 
@@ -0,0 +1,84 @@
+// Copyright 2015 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+//     Unless required by applicable law or agreed to in writing, software
+//     distributed under the License is distributed on an "AS IS" BASIS,
+//     WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+//     implied.
+//     See the License for the specific language governing permissions and
+//     limitations under the License.
+
+#include "src/cctz_stats.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "src/cctz_counters.h"
+#include "src/cctz_impl.h"
+
+namespace cctz {
+
+ShardedCounters<kNumGlobalCounters>& GlobalCounters() {
+  // Never destroyed, so that counting is safe during static destruction.
+  static ShardedCounters<kNumGlobalCounters>* const counters =
+      new ShardedCounters<kNumGlobalCounters>;
+  return *counters;
+}
+
+Stats GetStats() {
+  Stats stats = Stats();
+#ifdef CCTZ_STATS
+  stats.enabled = true;
+  const ShardedCounters<kNumGlobalCounters>& counters = GlobalCounters();
+  stats.strftime_fallbacks = counters.Sum(kStrftimeFallbacks);
+  stats.strptime_fallbacks = counters.Sum(kStrptimeFallbacks);
+  stats.utc_fallbacks = counters.Sum(kUTCFallbacks);
+#endif
+  TimeZone::Impl::CollectStats(&stats.zones, &stats.failed_zones);
+  std::sort(stats.zones.begin(), stats.zones.end(),
+            [](const ZoneStats& a, const ZoneStats& b) {
+              return a.name < b.name;
+            });
+  std::sort(stats.failed_zones.begin(), stats.failed_zones.end());
+  return stats;
+}
+
+void DumpStats(std::ostream& os) {
+  const Stats stats = GetStats();
+  os << "cctz: " << (stats.enabled ? "" : "(CCTZ_STATS disabled) ")
+     << stats.zones.size() << " zones, "
+     << stats.failed_zones.size() << " failed, "
+     << "utc_fallbacks=" << stats.utc_fallbacks
+     << " strftime_fallbacks=" << stats.strftime_fallbacks
+     << " strptime_fallbacks=" << stats.strptime_fallbacks << "\n";
+  for (const ZoneStats& z : stats.zones) {
+    if (z.break_time + z.break_times_rows + z.make_time +
+            z.make_times_rows == 0) {
+      continue;
+    }
+    os << z.name << ": loads=" << z.loads
+       << " load_us=" << z.load_time.count() / 1000
+       << " break_time=" << z.break_time
+       << " break_times_rows=" << z.break_times_rows
+       << " break_times_searches=" << z.break_times_searches
+       << " make_time=" << z.make_time
+       << " make_times_rows=" << z.make_times_rows
+       << " make_times_searches=" << z.make_times_searches
+       << " make_times_fallbacks=" << z.make_times_fallbacks
+       << " future_shifts=" << z.future_shifts << "\n";
+  }
+  for (const std::string& name : stats.failed_zones) {
+    os << name << ": failed (UTC)\n";
+  }
+}
+
+}  // namespace cctz
@@ -0,0 +1,75 @@
+// Copyright 2015 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+//     Unless required by applicable law or agreed to in writing, software
+//     distributed under the License is distributed on an "AS IS" BASIS,
+//     WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+//     implied.
+//     See the License for the specific language governing permissions and
+//     limitations under the License.
+
+// Statistics on how the library is used: for each loaded zone, how many
+// conversions it did and how they were resolved, and how long its loads
+// took, and for the library as a whole, how often formatting and parsing
+// fell back to strftime(3) and strptime(3), and how often LoadTimeZone()
+// failed and fell back to UTC.
+//
+// The counters are only kept when the library is built with CCTZ_STATS
+// defined (e.g., bazel build --copt=-DCCTZ_STATS), and otherwise compile
+// away entirely, leaving every count zero. They are sharded relaxed atomics,
+// so that threads converting concurrently rarely share a cache line, and a
+// query sums the shards as they stand, without stopping other threads.
+// Conversions through a default-constructed TimeZone are not counted.
+
+#ifndef CCTZ_STATS_H_
+#define CCTZ_STATS_H_
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace cctz {
+
+// The counts for one loaded zone, which survive ReloadTimeZones().
+struct ZoneStats {
+  std::string name;
+  uint64_t loads;                       // loads of its data, with reloads
+  std::chrono::nanoseconds load_time;   // the total time they took
+  uint64_t break_time;                  // single BreakTime() conversions
+  uint64_t break_times_rows;            // times converted by BreakTimes()
+  uint64_t break_times_searches;        // ... that searched the transitions
+  uint64_t make_time;                   // single MakeTime() conversions
+  uint64_t make_times_rows;             // rows converted by MakeTimes()
+  uint64_t make_times_searches;         // ... that searched the transitions
+  uint64_t make_times_fallbacks;        // ... that needed a MakeTimeInfo()
+  uint64_t future_shifts;               // 400-year shifts of far futures
+};
+
+// The counts for the library as a whole.
+struct Stats {
+  bool enabled;                    // whether built with CCTZ_STATS
+  uint64_t strftime_fallbacks;     // Format() conversions using strftime(3)
+  uint64_t strptime_fallbacks;     // Parse() conversions using strptime(3)
+  uint64_t utc_fallbacks;          // LoadTimeZone() failures (yielding UTC)
+  std::vector<std::string> failed_zones;  // the names that failed, sorted
+  std::vector<ZoneStats> zones;           // the loaded zones, by name
+};
+
+// Returns the current counts. Zones and failures are listed even when the
+// counters are not kept.
+Stats GetStats();
+
+// Writes GetStats() to os as text, one line for the library and one for
+// each zone that has converted anything or failed to load.
+void DumpStats(std::ostream& os);
+
+}  // namespace cctz
+
+#endif  // CCTZ_STATS_H_
@@ -0,0 +1,35 @@
+"""Compiles time zones into a binary, for hosts without zoneinfo files."""
+
+def cctz_embedded_zones(name, zones = [], zoneinfo = None, **kwargs):
+    """Defines a cc_library that builds the given zones into any binary.
+
+    The zones are decoded at build time into a zone bundle (see
+    cctz_bundle.h), which is compiled into read-only data and registered
+    when the binary starts, so loading them needs no file I/O. The zones
+    are taken from the zoneinfo files of the build host.
+
+    Args:
+      name: The name of the cc_library.
+      zones: The zones to embed, or all zones if empty.
+      zoneinfo: The host zoneinfo directory, if not ${TZDIR} or
+        /usr/share/zoneinfo.
+      **kwargs: Passed to the cc_library (e.g., visibility).
+    """
+    flags = " --cc"
+    if zoneinfo:
+        flags += " --zoneinfo=" + zoneinfo
+    native.genrule(
+        name = name + "_cc",
+        outs = [name + ".cc"],
+        cmd = ("$(location //tools:zone_bundle_tool)" + flags + " $@ " +
+               " ".join(zones) + " >/dev/null"),
+        tools = ["//tools:zone_bundle_tool"],
+        local = 1,  # reads the host zoneinfo files
+    )
+    native.cc_library(
+        name = name,
+        srcs = [name + ".cc"],
+        deps = ["//src:cctz"],
+        alwayslink = 1,  # registered only by a static initializer
+        **kwargs
+    )
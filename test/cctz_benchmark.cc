@@ -0,0 +1,585 @@
+// Copyright 2015 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+//     Unless required by applicable law or agreed to in writing, software
+//     distributed under the License is distributed on an "AS IS" BASIS,
+//     WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+//     implied.
+//     See the License for the specific language governing permissions and
+//     limitations under the License.
+
+#include "src/cctz.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <ctime>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+
+namespace {
+
+cctz::TimeZone LoadZone(const char* name) {
+  cctz::TimeZone tz;
+  cctz::LoadTimeZone(name, &tz);
+  return tz;
+}
+
+// Times spread over several years, so that consecutive conversions
+// rarely fall between the same pair of transitions.
+const std::vector<cctz::time_point>& SpreadTimes() {
+  static const std::vector<cctz::time_point>* const times = [] {
+    auto* v = new std::vector<cctz::time_point>;
+    const std::time_t kStart = 1262304000;  // 2010-01-01 00:00:00 UTC
+    std::mt19937 gen(12345);  // deterministic
+    std::uniform_int_distribution<std::time_t> dist(0, 10 * 365 * 86400);
+    for (int i = 0; i != 1024; ++i) {
+      v->push_back(std::chrono::system_clock::from_time_t(kStart + dist(gen)));
+    }
+    return v;
+  }();
+  return *times;
+}
+
+// Converts single times in zones of increasing generality: UTC, a fixed
+// offset, a zone with transitions (both converting the same time over and
+// over, and times spread over a decade), and the years far beyond the last
+// zic transition. The libc equivalents, in the same zone, are the baseline.
+void BM_BreakTime_UTC(benchmark::State& state) {
+  const cctz::TimeZone tz = cctz::UTCTimeZone();
+  const std::vector<cctz::time_point>& times = SpreadTimes();
+  std::size_t i = 0;
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(cctz::BreakTimeLite(times[i], tz));
+    if (++i == times.size()) i = 0;
+  }
+}
+BENCHMARK(BM_BreakTime_UTC);
+
+void BM_BreakTime_FixedOffset(benchmark::State& state) {
+  const cctz::TimeZone tz = LoadZone("Etc/GMT-3");
+  const std::vector<cctz::time_point>& times = SpreadTimes();
+  std::size_t i = 0;
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(cctz::BreakTimeLite(times[i], tz));
+    if (++i == times.size()) i = 0;
+  }
+}
+BENCHMARK(BM_BreakTime_FixedOffset);
+
+void BM_BreakTime_NewYorkRepeated(benchmark::State& state) {
+  const cctz::TimeZone tz = LoadZone("America/New_York");
+  const cctz::time_point tp = SpreadTimes()[0];
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(cctz::BreakTimeLite(tp, tz));
+  }
+}
+BENCHMARK(BM_BreakTime_NewYorkRepeated);
+
+void BM_BreakTime_NewYorkSpread(benchmark::State& state) {
+  const cctz::TimeZone tz = LoadZone("America/New_York");
+  const std::vector<cctz::time_point>& times = SpreadTimes();
+  std::size_t i = 0;
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(cctz::BreakTimeLite(times[i], tz));
+    if (++i == times.size()) i = 0;
+  }
+}
+BENCHMARK(BM_BreakTime_NewYorkSpread);
+
+// The same times given as 64-bit system_clock time_points.
+void BM_BreakTime_NewYorkSpreadSystemClock(benchmark::State& state) {
+  const cctz::TimeZone tz = LoadZone("America/New_York");
+  std::vector<std::chrono::system_clock::time_point> times;
+  for (const cctz::time_point& tp : SpreadTimes()) {
+    times.push_back(std::chrono::system_clock::from_time_t(0) +
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        tp - std::chrono::system_clock::from_time_t(0)));
+  }
+  std::size_t i = 0;
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(cctz::BreakTimeLite(times[i], tz));
+    if (++i == times.size()) i = 0;
+  }
+}
+BENCHMARK(BM_BreakTime_NewYorkSpreadSystemClock);
+
+void BM_BreakTime_NewYorkFarFuture(benchmark::State& state) {
+  const cctz::TimeZone tz = LoadZone("America/New_York");
+  std::vector<cctz::time_point> times;
+  for (const cctz::time_point& tp : SpreadTimes()) {
+    times.push_back(tp + std::chrono::hours(24 * 365 * 1000));  // ~3010
+  }
+  std::size_t i = 0;
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(cctz::BreakTimeLite(times[i], tz));
+    if (++i == times.size()) i = 0;
+  }
+}
+BENCHMARK(BM_BreakTime_NewYorkFarFuture);
+
+// Finds the start of the local day of each time, as when rolling times up
+// by day, and the same through a round trip via MakeTime().
+void BM_StartOfDay_NewYorkSpread(benchmark::State& state) {
+  const cctz::TimeZone tz = LoadZone("America/New_York");
+  const std::vector<cctz::time_point>& times = SpreadTimes();
+  std::size_t i = 0;
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(cctz::StartOfDay(times[i], tz));
+    if (++i == times.size()) i = 0;
+  }
+}
+BENCHMARK(BM_StartOfDay_NewYorkSpread);
+
+void BM_StartOfDay_NewYorkSpreadRoundTrip(benchmark::State& state) {
+  const cctz::TimeZone tz = LoadZone("America/New_York");
+  const std::vector<cctz::time_point>& times = SpreadTimes();
+  std::size_t i = 0;
+  while (state.KeepRunning()) {
+    const cctz::BreakdownLite bd = cctz::BreakTimeLite(times[i], tz);
+    benchmark::DoNotOptimize(
+        cctz::MakeTime(bd.year, bd.month, bd.day, 0, 0, 0, tz));
+    if (++i == times.size()) i = 0;
+  }
+}
+BENCHMARK(BM_StartOfDay_NewYorkSpreadRoundTrip);
+
+// Makes the libc local time zone that of New York. Only the first call
+// changes the environment, so that the threads of a multi-threaded run
+// cannot change it under one another's localtime_r() and mktime() calls.
+void UseNewYorkLocalTime() {
+  static const bool done = [] {
+    setenv("TZ", "America/New_York", 1);
+    tzset();
+    return true;
+  }();
+  (void)done;
+}
+
+void BM_BreakTime_LibC(benchmark::State& state) {
+  UseNewYorkLocalTime();
+  const std::vector<cctz::time_point>& times = SpreadTimes();
+  std::vector<std::time_t> secs;
+  for (const cctz::time_point& tp : times) {
+    secs.push_back(std::chrono::system_clock::to_time_t(tp));
+  }
+  std::size_t i = 0;
+  std::tm tm;
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(localtime_r(&secs[i], &tm));
+    if (++i == secs.size()) i = 0;
+  }
+}
+BENCHMARK(BM_BreakTime_LibC)->ThreadRange(1, 64);
+
+void BM_MakeTime_NewYork(benchmark::State& state) {
+  const cctz::TimeZone tz = LoadZone("America/New_York");
+  std::vector<cctz::BreakdownLite> civils;
+  for (const cctz::time_point& tp : SpreadTimes()) {
+    civils.push_back(cctz::BreakTimeLite(tp, tz));
+  }
+  std::size_t i = 0;
+  while (state.KeepRunning()) {
+    const cctz::BreakdownLite& bd = civils[i];
+    benchmark::DoNotOptimize(cctz::MakeTime(
+        bd.year, bd.month, bd.day, bd.hour, bd.minute, bd.second, tz));
+    if (++i == civils.size()) i = 0;
+  }
+}
+BENCHMARK(BM_MakeTime_NewYork);
+
+void BM_MakeTime_LibC(benchmark::State& state) {
+  UseNewYorkLocalTime();
+  std::vector<std::tm> tms;
+  for (const cctz::time_point& tp : SpreadTimes()) {
+    const std::time_t t = std::chrono::system_clock::to_time_t(tp);
+    std::tm tm;
+    localtime_r(&t, &tm);
+    tm.tm_isdst = -1;
+    tms.push_back(tm);
+  }
+  std::size_t i = 0;
+  while (state.KeepRunning()) {
+    std::tm tm = tms[i];
+    benchmark::DoNotOptimize(std::mktime(&tm));
+    if (++i == tms.size()) i = 0;
+  }
+}
+BENCHMARK(BM_MakeTime_LibC)->ThreadRange(1, 64);
+
+// The same conversions through "libc:localtime", which calls the C library,
+// and "libc:snapshot", which decodes the zone it would use once.
+void BM_BreakTime_LibCZone(benchmark::State& state) {
+  UseNewYorkLocalTime();
+  const cctz::TimeZone tz =
+      LoadZone(state.range(0) ? "libc:snapshot" : "libc:localtime");
+  const std::vector<cctz::time_point>& times = SpreadTimes();
+  std::size_t i = 0;
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(cctz::BreakTimeLite(times[i], tz));
+    if (++i == times.size()) i = 0;
+  }
+}
+BENCHMARK(BM_BreakTime_LibCZone)->Arg(0)->Arg(1)->ThreadRange(1, 64);
+
+void BM_MakeTime_LibCZone(benchmark::State& state) {
+  UseNewYorkLocalTime();
+  const cctz::TimeZone tz =
+      LoadZone(state.range(0) ? "libc:snapshot" : "libc:localtime");
+  std::vector<cctz::BreakdownLite> civils;
+  for (const cctz::time_point& tp : SpreadTimes()) {
+    civils.push_back(cctz::BreakTimeLite(tp, tz));
+  }
+  std::size_t i = 0;
+  while (state.KeepRunning()) {
+    const cctz::BreakdownLite& bd = civils[i];
+    benchmark::DoNotOptimize(cctz::MakeTime(
+        bd.year, bd.month, bd.day, bd.hour, bd.minute, bd.second, tz));
+    if (++i == civils.size()) i = 0;
+  }
+}
+BENCHMARK(BM_MakeTime_LibCZone)->Arg(0)->Arg(1)->ThreadRange(1, 64);
+
+// Converts times spread across a decade in a single popular zone from
+// every thread. The transition search must not write to the shared zone
+// data or this would stop scaling with the number of threads.
+void BM_BreakTime_SpreadMultiThreaded(benchmark::State& state) {
+  const cctz::TimeZone tz = LoadZone("America/New_York");
+  const std::vector<cctz::time_point>& times = SpreadTimes();
+  std::size_t i = 0;
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(cctz::BreakTimeLite(times[i], tz));
+    if (++i == times.size()) i = 0;
+  }
+}
+BENCHMARK(BM_BreakTime_SpreadMultiThreaded)->ThreadRange(1, 64);
+
+void BM_MakeTimeInfo_SpreadMultiThreaded(benchmark::State& state) {
+  const cctz::TimeZone tz = LoadZone("America/New_York");
+  std::vector<cctz::BreakdownLite> civils;
+  for (const cctz::time_point& tp : SpreadTimes()) {
+    civils.push_back(cctz::BreakTimeLite(tp, tz));
+  }
+  std::size_t i = 0;
+  while (state.KeepRunning()) {
+    const cctz::BreakdownLite& bd = civils[i];
+    benchmark::DoNotOptimize(cctz::MakeTimeInfo(
+        bd.year, bd.month, bd.day, bd.hour, bd.minute, bd.second, tz));
+    if (++i == civils.size()) i = 0;
+  }
+}
+BENCHMARK(BM_MakeTimeInfo_SpreadMultiThreaded)->ThreadRange(1, 64);
+
+// Converts a column of sorted times, one at a time and then as a batch.
+std::vector<int64_t> SortedSeconds() {
+  std::vector<int64_t> secs;
+  for (int64_t t = 1262304000; secs.size() != 65536; t += 4817) {
+    secs.push_back(t);
+  }
+  return secs;
+}
+
+void BM_BreakTime_SortedColumn(benchmark::State& state) {
+  const cctz::TimeZone tz = LoadZone("America/New_York");
+  const std::vector<int64_t> secs = SortedSeconds();
+  std::vector<int64_t> years(secs.size());
+  std::vector<int> months(secs.size()), days(secs.size());
+  std::vector<int> hours(secs.size());
+  while (state.KeepRunning()) {
+    for (std::size_t i = 0; i != secs.size(); ++i) {
+      const cctz::BreakdownLite bd = cctz::BreakTimeLite(
+          std::chrono::system_clock::from_time_t(secs[i]), tz);
+      years[i] = bd.year;
+      months[i] = bd.month;
+      days[i] = bd.day;
+      hours[i] = bd.hour;
+    }
+    benchmark::DoNotOptimize(years.data());
+  }
+  state.SetItemsProcessed(state.iterations() * secs.size());
+}
+BENCHMARK(BM_BreakTime_SortedColumn);
+
+void BM_BreakTimes_SortedColumn(benchmark::State& state) {
+  const cctz::TimeZone tz = LoadZone("America/New_York");
+  const std::vector<int64_t> secs = SortedSeconds();
+  std::vector<int64_t> years(secs.size());
+  std::vector<int> months(secs.size()), days(secs.size());
+  std::vector<int> hours(secs.size());
+  cctz::BreakdownColumns cols;
+  cols.year = years.data();
+  cols.month = months.data();
+  cols.day = days.data();
+  cols.hour = hours.data();
+  while (state.KeepRunning()) {
+    cctz::BreakTimes(secs.data(), secs.size(), tz, cols);
+    benchmark::DoNotOptimize(years.data());
+  }
+  state.SetItemsProcessed(state.iterations() * secs.size());
+}
+BENCHMARK(BM_BreakTimes_SortedColumn);
+
+void BM_MakeTimes_SortedColumn(benchmark::State& state) {
+  const cctz::TimeZone tz = LoadZone("America/New_York");
+  const std::vector<int64_t> secs = SortedSeconds();
+  std::vector<int64_t> years(secs.size());
+  std::vector<int> months(secs.size()), days(secs.size());
+  std::vector<int> hours(secs.size()), minutes(secs.size());
+  std::vector<int> seconds(secs.size());
+  cctz::BreakdownColumns bd;
+  bd.year = years.data();
+  bd.month = months.data();
+  bd.day = days.data();
+  bd.hour = hours.data();
+  bd.minute = minutes.data();
+  bd.second = seconds.data();
+  cctz::BreakTimes(secs.data(), secs.size(), tz, bd);
+  cctz::CivilColumns civil;
+  civil.year = years.data();
+  civil.month = months.data();
+  civil.day = days.data();
+  civil.hour = hours.data();
+  civil.minute = minutes.data();
+  civil.second = seconds.data();
+  std::vector<int64_t> out(secs.size());
+  std::vector<cctz::TimeInfo::Kind> kinds(secs.size());
+  while (state.KeepRunning()) {
+    cctz::MakeTimes(civil, secs.size(), tz, out.data(), kinds.data());
+    benchmark::DoNotOptimize(out.data());
+  }
+  state.SetItemsProcessed(state.iterations() * secs.size());
+}
+BENCHMARK(BM_MakeTimes_SortedColumn);
+
+// Formats a log-style timestamp, rescanning the pattern every time and
+// then with the pattern compiled once.
+const char kLogFormat[] = "%Y-%m-%d %H:%M:%E6S %Ez";
+
+void BM_Format(benchmark::State& state) {
+  const cctz::TimeZone tz = LoadZone("America/New_York");
+  const std::vector<cctz::time_point>& times = SpreadTimes();
+  std::size_t i = 0;
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(cctz::Format(kLogFormat, times[i], tz));
+    if (++i == times.size()) i = 0;
+  }
+}
+BENCHMARK(BM_Format);
+
+void BM_Format_Compiled(benchmark::State& state) {
+  const cctz::TimeZone tz = LoadZone("America/New_York");
+  const cctz::CompiledFormat format(kLogFormat);
+  const std::vector<cctz::time_point>& times = SpreadTimes();
+  std::size_t i = 0;
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(cctz::Format(format, times[i], tz));
+    if (++i == times.size()) i = 0;
+  }
+}
+BENCHMARK(BM_Format_Compiled);
+
+void BM_Format_CompiledToBuffer(benchmark::State& state) {
+  const cctz::TimeZone tz = LoadZone("America/New_York");
+  const cctz::CompiledFormat format(kLogFormat);
+  const std::vector<cctz::time_point>& times = SpreadTimes();
+  char buf[64];
+  std::size_t i = 0;
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(
+        cctz::Format(format, times[i], tz, buf, sizeof(buf)));
+    if (++i == times.size()) i = 0;
+  }
+}
+BENCHMARK(BM_Format_CompiledToBuffer);
+
+// Formats times as a logger would, many to each second, first compiled and
+// then cached, and then cached with the spread times, which always miss.
+const std::vector<cctz::time_point>& LogTimes() {
+  static const std::vector<cctz::time_point>* const times = [] {
+    auto* v = new std::vector<cctz::time_point>;
+    cctz::time_point tp = std::chrono::system_clock::from_time_t(1262304000);
+    for (int i = 0; i != 1024; ++i) {
+      v->push_back(tp);
+      tp += std::chrono::microseconds(37);
+    }
+    return v;
+  }();
+  return *times;
+}
+
+void BM_Format_CompiledLogTimes(benchmark::State& state) {
+  const cctz::TimeZone tz = LoadZone("America/New_York");
+  const cctz::CompiledFormat format(kLogFormat);
+  const std::vector<cctz::time_point>& times = LogTimes();
+  char buf[64];
+  std::size_t i = 0;
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(
+        cctz::Format(format, times[i], tz, buf, sizeof(buf)));
+    if (++i == times.size()) i = 0;
+  }
+}
+BENCHMARK(BM_Format_CompiledLogTimes);
+
+void BM_Format_CachedLogTimes(benchmark::State& state) {
+  const cctz::TimeZone tz = LoadZone("America/New_York");
+  const cctz::CachedFormat format(kLogFormat);
+  const std::vector<cctz::time_point>& times = LogTimes();
+  char buf[64];
+  std::size_t i = 0;
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(
+        cctz::Format(format, times[i], tz, buf, sizeof(buf)));
+    if (++i == times.size()) i = 0;
+  }
+}
+BENCHMARK(BM_Format_CachedLogTimes);
+
+void BM_Format_CachedSpreadTimes(benchmark::State& state) {
+  const cctz::TimeZone tz = LoadZone("America/New_York");
+  const cctz::CachedFormat format(kLogFormat);
+  const std::vector<cctz::time_point>& times = SpreadTimes();
+  char buf[64];
+  std::size_t i = 0;
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(
+        cctz::Format(format, times[i], tz, buf, sizeof(buf)));
+    if (++i == times.size()) i = 0;
+  }
+}
+BENCHMARK(BM_Format_CachedSpreadTimes);
+
+// Parses RFC3339 timestamps, which Parse() recognizes, and then the same
+// inputs with an equivalent format that it does not.
+std::vector<std::string> RFC3339Inputs() {
+  const cctz::TimeZone tz = LoadZone("America/New_York");
+  std::vector<std::string> inputs;
+  for (const cctz::time_point& tp : SpreadTimes()) {
+    inputs.push_back(cctz::Format("%Y-%m-%dT%H:%M:%E6S%Ez", tp, tz));
+  }
+  return inputs;
+}
+
+void BM_Parse_RFC3339(benchmark::State& state) {
+  const cctz::TimeZone tz = LoadZone("America/New_York");
+  const std::vector<std::string> inputs = RFC3339Inputs();
+  cctz::time_point tp;
+  std::size_t i = 0;
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(
+        cctz::Parse("%Y-%m-%dT%H:%M:%E*S%Ez", inputs[i], tz, &tp));
+    if (++i == inputs.size()) i = 0;
+  }
+}
+BENCHMARK(BM_Parse_RFC3339);
+
+void BM_Parse_RFC3339General(benchmark::State& state) {
+  const cctz::TimeZone tz = LoadZone("America/New_York");
+  const std::vector<std::string> inputs = RFC3339Inputs();
+  cctz::time_point tp;
+  std::size_t i = 0;
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(
+        cctz::Parse(" %Y-%m-%dT%H:%M:%E*S%Ez", inputs[i], tz, &tp));
+    if (++i == inputs.size()) i = 0;
+  }
+}
+BENCHMARK(BM_Parse_RFC3339General);
+
+// Formats and parses some other common patterns.
+const char* const kPatterns[] = {
+    "%Y-%m-%d %H:%M:%S",            // 0: ISO 8601-ish
+    "%a, %d %b %Y %H:%M:%S %z",     // 1: RFC 1123
+    "%d/%b/%Y:%H:%M:%S %z",         // 2: Common Log Format
+    "%Y-%m-%dT%H:%M:%E3S%Ez",       // 3: RFC 3339, with milliseconds
+};
+
+void BM_Format_Pattern(benchmark::State& state) {
+  const cctz::TimeZone tz = LoadZone("America/New_York");
+  const cctz::CompiledFormat format(kPatterns[state.range(0)]);
+  const std::vector<cctz::time_point>& times = SpreadTimes();
+  std::string s;
+  std::size_t i = 0;
+  while (state.KeepRunning()) {
+    s.clear();
+    cctz::Format(format, times[i], tz, &s);
+    benchmark::DoNotOptimize(s.data());
+    if (++i == times.size()) i = 0;
+  }
+}
+BENCHMARK(BM_Format_Pattern)->DenseRange(0, 3);
+
+void BM_Format_LibC(benchmark::State& state) {
+  UseNewYorkLocalTime();
+  const char* const pattern = kPatterns[state.range(0)];
+  std::vector<std::time_t> secs;
+  for (const cctz::time_point& tp : SpreadTimes()) {
+    secs.push_back(std::chrono::system_clock::to_time_t(tp));
+  }
+  char buf[64];
+  std::size_t i = 0;
+  std::tm tm;
+  while (state.KeepRunning()) {
+    localtime_r(&secs[i], &tm);
+    benchmark::DoNotOptimize(std::strftime(buf, sizeof(buf), pattern, &tm));
+    if (++i == secs.size()) i = 0;
+  }
+}
+BENCHMARK(BM_Format_LibC)->DenseRange(0, 2);  // no %E3S or %Ez in libc
+
+void BM_Parse_Pattern(benchmark::State& state) {
+  const cctz::TimeZone tz = LoadZone("America/New_York");
+  const char* const pattern = kPatterns[state.range(0)];
+  const cctz::CompiledParser parser(pattern);
+  std::vector<std::string> inputs;
+  for (const cctz::time_point& tp : SpreadTimes()) {
+    inputs.push_back(cctz::Format(pattern, tp, tz));
+  }
+  cctz::time_point tp;
+  std::size_t i = 0;
+  while (state.KeepRunning()) {
+    const std::string& in = inputs[i];
+    benchmark::DoNotOptimize(
+        cctz::Parse(parser, in.data(), in.size(), tz, &tp));
+    if (++i == inputs.size()) i = 0;
+  }
+}
+BENCHMARK(BM_Parse_Pattern)->DenseRange(0, 3);
+
+// Loads zones that are already loaded, from many threads at once, and then
+// zones that are not, each for the first time.
+void BM_LoadTimeZone_Cached(benchmark::State& state) {
+  LoadZone("America/New_York");
+  cctz::TimeZone tz;
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(cctz::LoadTimeZone("America/New_York", &tz));
+  }
+}
+BENCHMARK(BM_LoadTimeZone_Cached)->ThreadRange(1, 64);
+
+void BM_LoadTimeZone_FirstTime(benchmark::State& state) {
+  static std::vector<std::string>* const names =
+      new std::vector<std::string>(cctz::ZoneinfoNames());
+  static std::size_t next = 0;  // each name is only loaded once
+  cctz::TimeZone tz;
+  while (state.KeepRunning()) {
+    if (next == names->size()) {
+      state.SkipWithError("out of zones");
+      break;
+    }
+    cctz::LoadTimeZone((*names)[next++], &tz);
+  }
+}
+BENCHMARK(BM_LoadTimeZone_FirstTime)->Iterations(400);
+
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -15,13 +15,26 @@
 
 #include "src/cctz.h"
 
+#include <algorithm>
 #include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
 #include <future>
+#include <limits>
+#include <memory>
 #include <string>
 #include <thread>
+#include <utility>
 #include <vector>
 
 #include "gtest/gtest.h"
+#include "src/cctz_bundle.h"
+#include "src/cctz_civil.h"
+#include "src/cctz_stats.h"
 
 using std::chrono::system_clock;
 
@@ -666,6 +679,141 @@ TEST(TimeZones, LoadZonesConcurrently) {
   }
 }
 
+TEST(TimeZones, ZoneinfoNames) {
+  const std::vector<std::string> names = ZoneinfoNames();
+  EXPECT_LT(100u, names.size());
+  EXPECT_TRUE(std::is_sorted(names.begin(), names.end()));
+  EXPECT_TRUE(std::binary_search(names.begin(), names.end(),
+                                 "America/New_York"));
+  for (const std::string& name : names) {
+    EXPECT_NE(0, name.compare(0, 6, "posix/")) << name;
+    EXPECT_NE(0, name.compare(0, 6, "right/")) << name;
+    EXPECT_NE("localtime", name);
+    EXPECT_NE("zone.tab", name);  // not zoneinfo data
+  }
+}
+
+TEST(TimeZones, PreloadZones) {
+  // Zones that nothing else loads, so that they are loaded here.
+  const std::vector<std::string> names = {
+      "posix/Europe/Oslo", "posix/Asia/Tokyo", "posix/Asia/Tokyo",
+      "No/Such_Zone", "UTC"};
+  EXPECT_EQ(4u, PreloadTimeZones(names));
+  TimeZone tz;
+  EXPECT_TRUE(LoadTimeZone("posix/Asia/Tokyo", &tz));
+  EXPECT_EQ(9 * 60 * 60, BreakTime(system_clock::from_time_t(0), tz).offset);
+  EXPECT_FALSE(LoadTimeZone("No/Such_Zone", &tz));
+
+  // Every zone of the zoneinfo tree.
+  EXPECT_LT(100u, PreloadTimeZones());
+  EXPECT_TRUE(LoadTimeZone("Europe/Oslo", &tz));
+}
+
+TEST(TimeZones, ReloadZones) {
+  // Switch the local zone by rewriting the file it is loaded from.
+  const std::string path = testing::TempDir() + "/cnv_test.localtime";
+  auto install = [&path](const std::string& name) {
+    std::ifstream src("/usr/share/zoneinfo/" + name, std::ios::binary);
+    std::ofstream(path, std::ios::binary | std::ios::trunc) << src.rdbuf();
+  };
+  const char* const localtime = std::getenv("LOCALTIME");
+  const std::string saved_localtime = localtime ? localtime : "";
+  setenv("LOCALTIME", path.c_str(), 1);
+  install("Asia/Tokyo");
+  ReloadTimeZones();  // in case the local zone was already loaded
+  TimeZone tz;
+  ASSERT_TRUE(LoadTimeZone("localtime", &tz));
+  const time_point tp = system_clock::from_time_t(0);
+  EXPECT_EQ(9 * 60 * 60, BreakTime(tp, tz).offset);
+
+  install("Europe/Oslo");
+  EXPECT_LT(0u, ReloadTimeZones());
+  EXPECT_EQ(1 * 60 * 60, BreakTime(tp, tz).offset);  // the same TimeZone
+
+  if (localtime) {
+    setenv("LOCALTIME", saved_localtime.c_str(), 1);
+  } else {
+    unsetenv("LOCALTIME");
+  }
+  ReloadTimeZones();
+  std::remove(path.c_str());
+}
+
+TEST(TimeZones, LibCSnapshot) {
+  // "libc:snapshot" resolves ${TZ} once, and then agrees with the C library.
+  const char* const saved = std::getenv("TZ");
+  const std::string saved_tz = saved ? saved : "";
+  setenv("TZ", "America/New_York", 1);
+  tzset();
+  ReloadTimeZones();  // in case either zone was already loaded
+  const TimeZone snap = LoadZone("libc:snapshot");
+  const TimeZone libc = LoadZone("libc:localtime");
+  for (int64_t t = -(int64_t{1} << 31); t < (int64_t{1} << 31);
+       t += 86400 * 7 + 3599) {
+    const time_point tp = system_clock::from_time_t(t);
+    const Breakdown bs = BreakTime(tp, snap);
+    const Breakdown bl = BreakTime(tp, libc);
+    ExpectTime(bs, bl.year, bl.month, bl.day, bl.hour, bl.minute, bl.second,
+               bl.offset, bl.is_dst, bl.abbr);
+    EXPECT_EQ(tp, MakeTime(bs.year, bs.month, bs.day,
+                           bs.hour, bs.minute, bs.second, snap));
+  }
+  // Unlike mktime(3), it knows which civil times are skipped.
+  EXPECT_EQ(TimeInfo::Kind::SKIPPED,
+            MakeTimeInfo(2011, 3, 13, 2, 15, 0, snap).kind);
+
+  // It only sees a change to ${TZ} on a reload, and honors its forms.
+  const time_point epoch = system_clock::from_time_t(0);
+  setenv("TZ", ":Asia/Tokyo", 1);
+  EXPECT_EQ(-5 * 60 * 60, BreakTime(epoch, snap).offset);
+  ReloadTimeZones();
+  EXPECT_EQ(9 * 60 * 60, BreakTime(epoch, snap).offset);
+  setenv("TZ", "", 1);
+  ReloadTimeZones();
+  const Breakdown bd = BreakTime(epoch, snap);
+  ExpectTime(bd, 1970, 1, 1, 0, 0, 0, 0, false, "UTC");
+
+  if (saved) {
+    setenv("TZ", saved_tz.c_str(), 1);
+  } else {
+    unsetenv("TZ");
+  }
+  tzset();
+  ReloadTimeZones();
+}
+
+TEST(TimeZone, DefaultIsUTC) {
+  // A default-constructed TimeZone is converted without loading UTC, but
+  // must agree with it everywhere.
+  const TimeZone implicit_utc;
+  const TimeZone utc = UTCTimeZone();
+  const int64_t kSeconds[] = {
+      std::numeric_limits<int64_t>::min(), -62135596801, -1, 0, 1,
+      951782400, 4102444800, std::numeric_limits<int64_t>::max()};
+  for (const int64_t s : kSeconds) {
+    time_point tp = system_clock::from_time_t(0);
+    tp += std::chrono::seconds(s);  // in 128 bits
+    const Breakdown bd = BreakTime(tp, implicit_utc);
+    const Breakdown expected = BreakTime(tp, utc);
+    EXPECT_EQ(expected.year, bd.year) << s;
+    EXPECT_EQ(expected.month, bd.month) << s;
+    EXPECT_EQ(expected.day, bd.day) << s;
+    EXPECT_EQ(expected.hour, bd.hour) << s;
+    EXPECT_EQ(expected.minute, bd.minute) << s;
+    EXPECT_EQ(expected.second, bd.second) << s;
+    EXPECT_EQ(expected.weekday, bd.weekday) << s;
+    EXPECT_EQ(expected.yearday, bd.yearday) << s;
+    EXPECT_EQ(expected.offset, bd.offset) << s;
+    EXPECT_EQ(expected.is_dst, bd.is_dst) << s;
+    EXPECT_EQ(expected.abbr, bd.abbr) << s;
+  }
+  const TimeInfo ti = MakeTimeInfo(2013, 13, 1, 24, 0, 0, implicit_utc);
+  const TimeInfo expected = MakeTimeInfo(2013, 13, 1, 24, 0, 0, utc);
+  EXPECT_EQ(expected.kind, ti.kind);
+  EXPECT_EQ(expected.normalized, ti.normalized);
+  EXPECT_EQ(expected.pre, ti.pre);
+}
+
 TEST(TimeZone, Failures) {
   TimeZone tz;
   EXPECT_FALSE(LoadTimeZone(":America/Los_Angeles", &tz));
@@ -688,6 +836,161 @@ TEST(TimeZone, Failures) {
             MakeTime(1970, 1, 1, 0, 0, 0, tz));  // UTC
 }
 
+TEST(TimeZone, LoadFromCharArray) {
+  const TimeZone nyc = LoadZone("America/New_York");
+  const time_point tp = MakeTime(2013, 7, 1, 12, 0, 0, nyc);
+
+  // A name in the middle of some larger buffer.
+  const char kBuffer[] = "tz=America/New_York;tz=America/New_Yorker";
+  TimeZone tz;
+  EXPECT_TRUE(LoadTimeZone(kBuffer + 3, 16, &tz));
+  EXPECT_EQ(tp, MakeTime(2013, 7, 1, 12, 0, 0, tz));
+  EXPECT_FALSE(LoadTimeZone(kBuffer + 23, 18, &tz));
+  EXPECT_EQ(system_clock::from_time_t(0),
+            MakeTime(1970, 1, 1, 0, 0, 0, tz));  // UTC
+  EXPECT_TRUE(LoadTimeZone(kBuffer + 23, 16, &tz));
+  EXPECT_EQ(tp, MakeTime(2013, 7, 1, 12, 0, 0, tz));
+
+  // A NUL-terminated name.
+  const char* const name = "America/New_York";
+  EXPECT_TRUE(LoadTimeZone(name, &tz));
+  EXPECT_EQ(tp, MakeTime(2013, 7, 1, 12, 0, 0, tz));
+  EXPECT_TRUE(LoadTimeZone("UTC", 3, &tz));
+  EXPECT_FALSE(LoadTimeZone("", 0, &tz));
+}
+
+TEST(TimeZone, LoadFromBundle) {
+  // Zones that nothing else loads, so that they cannot already be cached.
+  std::vector<std::string> names = {"posix/Pacific/Chatham",
+                                    "posix/Etc/GMT+5", "No/Such_Zone"};
+  std::string bundle;
+  std::vector<std::string> skipped;
+  BuildZoneBundle(names, &bundle, &skipped);
+  ASSERT_EQ(1u, skipped.size());
+  EXPECT_EQ("No/Such_Zone", skipped[0]);
+  const std::string path = testing::TempDir() + "/cnv_test.bundle";
+  std::ofstream(path, std::ios::binary).write(bundle.data(), bundle.size());
+  ASSERT_TRUE(UseZoneBundle(path));
+  EXPECT_FALSE(UseZoneBundle(path + ".missing"));
+
+  // Load from the bundle only.
+  const char* const tzdir = std::getenv("TZDIR");
+  const std::string saved_tzdir = tzdir ? tzdir : "";
+  setenv("TZDIR", "/nonexistent", 1);
+  TimeZone chatham;
+  TimeZone gmt5;
+  const bool loaded_chatham = LoadTimeZone("posix/Pacific/Chatham", &chatham);
+  const bool loaded_gmt5 = LoadTimeZone("posix/Etc/GMT+5", &gmt5);
+  if (tzdir) {
+    setenv("TZDIR", saved_tzdir.c_str(), 1);
+  } else {
+    unsetenv("TZDIR");
+  }
+  ASSERT_TRUE(loaded_chatham);
+  ASSERT_TRUE(loaded_gmt5);
+
+  const TimeZone reference = LoadZone("Pacific/Chatham");
+  for (std::time_t t = -2000000000; t < 4000000000; t += 987654) {
+    const time_point tp = system_clock::from_time_t(t);
+    const Breakdown bd = BreakTime(tp, chatham);
+    const Breakdown ref = BreakTime(tp, reference);
+    EXPECT_EQ(ref.offset, bd.offset);
+    EXPECT_EQ(ref.abbr, bd.abbr);
+  }
+  const Breakdown bd = BreakTime(MakeTime(2013, 1, 1, 12, 0, 0, gmt5), gmt5);
+  ExpectTime(bd, 2013, 1, 1, 12, 0, 0, -5 * 60 * 60, false, "-05");
+  std::remove(path.c_str());
+}
+
+TEST(TimeZone, LoadFromBuiltinBundle) {
+  // As the cctz_embedded_zones() rule would compile into the binary.
+  std::string* const bundle = new std::string;  // lives forever
+  BuildZoneBundle({"posix/Asia/Kathmandu"}, bundle, nullptr);
+  ASSERT_TRUE(RegisterBuiltinZoneBundle(bundle->data(), bundle->size()));
+  EXPECT_FALSE(RegisterBuiltinZoneBundle(bundle->data(), 16));
+
+  const char* const tzdir = std::getenv("TZDIR");
+  const std::string saved_tzdir = tzdir ? tzdir : "";
+  setenv("TZDIR", "/nonexistent", 1);
+  TimeZone tz;
+  const bool loaded = LoadTimeZone("posix/Asia/Kathmandu", &tz);
+  if (tzdir) {
+    setenv("TZDIR", saved_tzdir.c_str(), 1);
+  } else {
+    unsetenv("TZDIR");
+  }
+  ASSERT_TRUE(loaded);
+  const Breakdown bd = BreakTime(MakeTime(2013, 7, 1, 12, 0, 0, tz), tz);
+  ExpectTime(bd, 2013, 7, 1, 12, 0, 0, 5 * 60 * 60 + 45 * 60, false, "+0545");
+}
+
+TEST(TimeZone, LoadFromCorruptBundle) {
+  // Swap the first two transitions of a zone that nothing else loads.
+  const TimeZone reference = LoadZone("Asia/Thimphu");
+  int64_t first = 0;
+  int64_t second = 0;
+  ASSERT_TRUE(NextTransition(std::numeric_limits<int64_t>::min() / 2,
+                             reference, &first));
+  ASSERT_TRUE(NextTransition(first, reference, &second));
+  std::string bundle;
+  BuildZoneBundle({"posix/Asia/Thimphu"}, &bundle, nullptr);
+  bool swapped = false;
+  for (std::size_t i = 0; i + 16 <= bundle.size(); i += 8) {
+    int64_t times[2];
+    std::memcpy(times, &bundle[i], sizeof times);
+    if (times[0] == first && times[1] == second) {
+      std::swap(times[0], times[1]);
+      std::memcpy(&bundle[i], times, sizeof times);
+      swapped = true;
+      break;
+    }
+  }
+  ASSERT_TRUE(swapped);
+  const std::string path = testing::TempDir() + "/cnv_test_corrupt.bundle";
+  std::ofstream(path, std::ios::binary).write(bundle.data(), bundle.size());
+  ASSERT_TRUE(UseZoneBundle(path));
+
+  // The record is rejected, so with no zoneinfo files the zone is absent.
+  const char* const tzdir = std::getenv("TZDIR");
+  const std::string saved_tzdir = tzdir ? tzdir : "";
+  setenv("TZDIR", "/nonexistent", 1);
+  TimeZone tz;
+  const bool loaded = LoadTimeZone("posix/Asia/Thimphu", &tz);
+  if (tzdir) {
+    setenv("TZDIR", saved_tzdir.c_str(), 1);
+  } else {
+    unsetenv("TZDIR");
+  }
+  EXPECT_FALSE(loaded);
+  std::remove(path.c_str());
+}
+
+TEST(TimeZone, Stats) {
+  const TimeZone tz = LoadZone("Asia/Tokyo");
+  TimeZone bad;
+  EXPECT_FALSE(LoadTimeZone("Invalid/Stats", &bad));
+  const time_point far = MakeTime(3000, 1, 1, 0, 0, 0, tz);
+  BreakTime(far, tz);
+
+  const Stats stats = GetStats();
+  const auto it = std::find_if(
+      stats.zones.begin(), stats.zones.end(),
+      [](const ZoneStats& z) { return z.name == "Asia/Tokyo"; });
+  ASSERT_NE(stats.zones.end(), it);
+  EXPECT_TRUE(std::binary_search(stats.failed_zones.begin(),
+                                 stats.failed_zones.end(), "Invalid/Stats"));
+  if (stats.enabled) {
+    EXPECT_LE(1, it->loads);
+    EXPECT_LE(1, it->break_time);
+    EXPECT_LE(1, it->make_time);
+    EXPECT_LE(1, stats.utc_fallbacks);
+  } else {
+    EXPECT_EQ(0, it->loads);
+    EXPECT_EQ(0, it->break_time);
+    EXPECT_EQ(0, stats.utc_fallbacks);
+  }
+}
+
 TEST(BreakTime, LocalTimeInUTC) {
   const Breakdown bd = BreakTime(system_clock::from_time_t(0), UTCTimeZone());
   ExpectTime(bd, 1970, 1, 1, 0, 0, 0, 0, false, "UTC");
@@ -723,6 +1026,173 @@ TEST(BreakTime, LocalTimeInSydney) {
   EXPECT_EQ(4, bd.weekday);  // Thursday
 }
 
+TEST(BreakTime, LiteMatchesBreakdown) {
+  const char* const kZones[] = {
+    "UTC", "America/New_York", "Australia/Lord_Howe", "Asia/Tehran", nullptr
+  };
+  for (const char* const* np = kZones; *np != nullptr; ++np) {
+    const TimeZone tz = LoadZone(*np);
+    for (std::time_t t = -1000000000; t <= 3000000000; t += 12345678) {
+      const time_point tp = system_clock::from_time_t(t);
+      const Breakdown bd = BreakTime(tp, tz);
+      const BreakdownLite bdl = BreakTimeLite(tp, tz);
+      ExpectTime(bdl, bd.year, bd.month, bd.day, bd.hour, bd.minute,
+                 bd.second, bd.offset, bd.is_dst, bd.abbr);
+      EXPECT_EQ(bd.subsecond, bdl.subsecond);
+      EXPECT_EQ(bd.weekday, bdl.weekday);
+      EXPECT_EQ(bd.yearday, bdl.yearday);
+    }
+  }
+
+  // The abbreviation is interned by the zone, so repeated conversions
+  // refer to the same storage.
+  const TimeZone tz = LoadZone("America/New_York");
+  const time_point tp = system_clock::from_time_t(0);
+  EXPECT_EQ(BreakTimeLite(tp, tz).abbr, BreakTimeLite(tp, tz).abbr);
+}
+
+TEST(BreakTime, SixtyFourBitMatchesTimePoint) {
+  using std::chrono::nanoseconds;
+  using std::chrono::seconds;
+  const TimeZone tz = LoadZone("America/New_York");
+  for (int64_t t = -2000000000; t <= 4000000000; t += 123456789) {
+    for (const int64_t ns : {int64_t{-1}, int64_t{0}, int64_t{999999999}}) {
+      time_point tp = system_clock::from_time_t(0);
+      tp += seconds(t);
+      tp += nanoseconds(ns);
+      const BreakdownLite expected = BreakTimeLite(tp, tz);
+      const system_clock::time_point stp =
+          system_clock::from_time_t(0) + seconds(t) + nanoseconds(ns);
+      for (const BreakdownLite& bd :
+           {BreakTimeLite(stp, tz), BreakTimeLite(t, nanoseconds(ns), tz)}) {
+        ExpectTime(bd, expected.year, expected.month, expected.day,
+                   expected.hour, expected.minute, expected.second,
+                   expected.offset, expected.is_dst, expected.abbr);
+        EXPECT_EQ(expected.subsecond, bd.subsecond);
+      }
+    }
+  }
+
+  // Whole seconds reach beyond the range of 64-bit nanoseconds.
+  const int64_t far = int64_t{1} << 40;
+  time_point tp = system_clock::from_time_t(0);
+  tp += seconds(far);
+  const Breakdown expected = BreakTime(tp, tz);
+  const Breakdown bd = BreakTime(
+      std::chrono::time_point<system_clock, seconds>(seconds(far)), tz);
+  ExpectTime(bd, expected.year, expected.month, expected.day, expected.hour,
+             expected.minute, expected.second, expected.offset,
+             expected.is_dst, expected.abbr);
+  EXPECT_EQ(duration::zero(), bd.subsecond);
+
+  // Subseconds outside [0s:1s) carry into the seconds.
+  ExpectTime(BreakTime(0, -seconds(1) - nanoseconds(1), tz),
+             1969, 12, 31, 18, 59, 58, -5 * 60 * 60, false, "EST");
+  EXPECT_EQ(nanoseconds(999999999),
+            BreakTimeLite(0, seconds(3) - nanoseconds(1), tz).subsecond);
+}
+
+TEST(BreakTime, BatchMatchesBreakTime) {
+  // Sorted times (which reuse the transition search), times in the
+  // generated future, and some unordered extremes.
+  std::vector<int64_t> secs;
+  for (int64_t t = -2000000000; t <= 4000000000; t += 863999)
+    secs.push_back(t);
+  for (int64_t t = 0; t < 10000; ++t) secs.push_back(1383458400 + t);
+  for (int64_t t = 5000000000; t <= 30000000000; t += 9876543)
+    secs.push_back(t);
+  for (int64_t t : {INT64_MIN, INT64_MIN + 1, int64_t{-1}, int64_t{0},
+                    INT64_MAX - 1, INT64_MAX, int64_t{1} << 40,
+                    -(int64_t{1} << 40), int64_t{1} << 59}) {
+    secs.push_back(t);
+  }
+  const std::size_t n = secs.size();
+  std::vector<time_point> tps(n);
+  for (std::size_t i = 0; i != n; ++i) {
+    tps[i] = system_clock::from_time_t(0);
+    tps[i] += std::chrono::seconds(secs[i]);
+    tps[i] += std::chrono::nanoseconds(static_cast<int>(i % 3) - 1);
+  }
+
+  const char* const kZones[] = {
+    "UTC", "America/New_York", "Australia/Lord_Howe", "Asia/Kathmandu",
+    "Pacific/Apia", "libc:UTC", nullptr
+  };
+  for (const char* const* np = kZones; *np != nullptr; ++np) {
+    const TimeZone tz = LoadZone(*np);
+    std::vector<int64_t> year(n);
+    std::vector<int> month(n), day(n), hour(n), minute(n), second(n);
+    std::vector<duration> subsecond(n);
+    std::vector<int> weekday(n), yearday(n), offset(n);
+    std::unique_ptr<bool[]> is_dst(new bool[n]);
+    std::vector<const char*> abbr(n);
+    BreakdownColumns cols;
+    cols.year = year.data();
+    cols.month = month.data();
+    cols.day = day.data();
+    cols.hour = hour.data();
+    cols.minute = minute.data();
+    cols.second = second.data();
+    cols.subsecond = subsecond.data();
+    cols.weekday = weekday.data();
+    cols.yearday = yearday.data();
+    cols.offset = offset.data();
+    cols.is_dst = is_dst.get();
+    cols.abbr = abbr.data();
+
+    BreakTimes(secs.data(), n, tz, cols);
+    const bool is_libc = std::string(*np).compare(0, 5, "libc:") == 0;
+    for (std::size_t i = 0; i != n; ++i) {
+      // The C library cannot represent the most extreme times.
+      if (is_libc && (secs[i] < -(int64_t{1} << 40) ||
+                      secs[i] > (int64_t{1} << 40))) continue;
+      time_point tp = system_clock::from_time_t(0);
+      tp += std::chrono::seconds(secs[i]);
+      const BreakdownLite bd = BreakTimeLite(tp, tz);
+      SCOPED_TRACE(testing::Message() << *np << " @ " << secs[i]);
+      EXPECT_EQ(bd.year, year[i]);
+      EXPECT_EQ(bd.month, month[i]);
+      EXPECT_EQ(bd.day, day[i]);
+      EXPECT_EQ(bd.hour, hour[i]);
+      EXPECT_EQ(bd.minute, minute[i]);
+      EXPECT_EQ(bd.second, second[i]);
+      EXPECT_EQ(duration::zero(), subsecond[i]);
+      EXPECT_EQ(bd.weekday, weekday[i]);
+      EXPECT_EQ(bd.yearday, yearday[i]);
+      EXPECT_EQ(bd.offset, offset[i]);
+      EXPECT_EQ(bd.is_dst, is_dst[i]);
+      EXPECT_STREQ(bd.abbr, abbr[i]);
+    }
+
+    // Only the requested columns are written, as the time_point overload
+    // also handles (negative) subseconds.
+    BreakdownColumns some;
+    some.year = year.data();
+    some.subsecond = subsecond.data();
+    BreakTimes(tps.data(), n, tz, some);
+    for (std::size_t i = 0; i != n; ++i) {
+      if (is_libc && (secs[i] < -(int64_t{1} << 40) ||
+                      secs[i] > (int64_t{1} << 40))) continue;
+      const BreakdownLite bd = BreakTimeLite(tps[i], tz);
+      EXPECT_EQ(bd.year, year[i]) << *np << " @ " << secs[i];
+      EXPECT_EQ(bd.subsecond, subsecond[i]) << *np << " @ " << secs[i];
+    }
+
+    // As are just the time-of-day columns.
+    BreakdownColumns clock;
+    clock.minute = minute.data();
+    std::fill(minute.begin(), minute.end(), -1);
+    BreakTimes(secs.data(), n, tz, clock);
+    for (std::size_t i = 0; i != n; ++i) {
+      if (is_libc && (secs[i] < -(int64_t{1} << 40) ||
+                      secs[i] > (int64_t{1} << 40))) continue;
+      const BreakdownLite bd =
+          BreakTimeLite(secs[i], std::chrono::nanoseconds::zero(), tz);
+      EXPECT_EQ(bd.minute, minute[i]) << *np << " @ " << secs[i];
+    }
+  }
+}
+
 TEST(MakeTime, Normalization) {
   const TimeZone tz = LoadZone("America/New_York");
   const time_point tp = MakeTime(2009, 2, 13, 18, 31, 30, tz);
@@ -736,6 +1206,319 @@ TEST(MakeTime, Normalization) {
   EXPECT_EQ(tp, MakeTime(2009, 2, 13, 18, 30, 90, tz));   // second
 }
 
+TEST(MakeTime, RoundTripsBreakTime) {
+  const char* const kZones[] = {
+    "America/New_York", "Europe/Moscow", "Australia/Lord_Howe", nullptr
+  };
+  for (const char* const* np = kZones; *np != nullptr; ++np) {
+    const TimeZone tz = LoadZone(*np);
+    // An odd step that lands on varying offsets from each transition.
+    for (std::time_t t = -2000000000; t <= 4000000000; t += 3607) {
+      const time_point tp = system_clock::from_time_t(t);
+      const BreakdownLite bd = BreakTimeLite(tp, tz);
+      const TimeInfo ti = MakeTimeInfo(bd.year, bd.month, bd.day,
+                                       bd.hour, bd.minute, bd.second, tz);
+      EXPECT_NE(TimeInfo::Kind::SKIPPED, ti.kind) << *np << " @ " << t;
+      EXPECT_TRUE(ti.pre == tp || ti.post == tp) << *np << " @ " << t;
+    }
+  }
+}
+
+// Civil times held as the columns of MakeTimes().
+struct CivilRows {
+  std::vector<int64_t> year;
+  std::vector<int> month, day, hour, minute, second;
+
+  void Add(int64_t y, int m, int d, int hh, int mm, int ss) {
+    year.push_back(y);
+    month.push_back(m);
+    day.push_back(d);
+    hour.push_back(hh);
+    minute.push_back(mm);
+    second.push_back(ss);
+  }
+  std::size_t size() const { return year.size(); }
+  CivilColumns Columns() const {
+    CivilColumns civil;
+    civil.year = year.data();
+    civil.month = month.data();
+    civil.day = day.data();
+    civil.hour = hour.data();
+    civil.minute = minute.data();
+    civil.second = second.data();
+    return civil;
+  }
+};
+
+TEST(MakeTime, BatchMatchesMakeTime) {
+  // Every half hour through several years of transitions, plus some
+  // out-of-range fields, extreme years, and years in the generated future.
+  // The C library cannot represent the most extreme times, so its zone is
+  // only given the others.
+  CivilRows rows, libc_rows;
+  for (int64_t y = 2010; y != 2014; ++y) {
+    for (int m = 1; m <= 12; ++m) {
+      for (int d = 1; d <= 31; ++d) {
+        for (int hm = 0; hm != 48; ++hm) {
+          rows.Add(y, m, d, hm / 2, hm % 2 * 30, hm % 7);
+          libc_rows.Add(y, m, d, hm / 2, hm % 2 * 30, hm % 7);
+        }
+      }
+    }
+  }
+  const struct {
+    int64_t year;
+    int month, day, hour, minute, second;
+  } kRows[] = {
+    {2013, 14, 3, 1, 30, 0}, {2013, 11, 33, 1, 30, 0}, {2013, 3, 10, 26, 0, 0},
+    {2013, 3, 10, 2, 75, 0}, {2013, 3, 10, 2, 30, 60}, {2013, 2, 29, 0, 0, 0},
+    {2012, 2, 29, 0, 0, 0}, {-1000000000, 1, 1, 0, 0, 0},
+    {1000000001, 1, 1, 0, 0, 0}, {INT64_MIN, 1, 1, 0, 0, 0},
+    {INT64_MAX, 12, 31, 23, 59, 59}, {2100, 3, 14, 2, 30, 0},
+    {2100, 11, 7, 1, 30, 0}, {12401, 6, 1, 12, 0, 0},
+  };
+  for (const auto& row : kRows) {
+    rows.Add(row.year, row.month, row.day, row.hour, row.minute, row.second);
+    if (-1000000 <= row.year && row.year <= 1000000) {
+      libc_rows.Add(row.year, row.month, row.day,
+                    row.hour, row.minute, row.second);
+    }
+  }
+
+  const char* const kZones[] = {
+    "UTC", "America/New_York", "Australia/Lord_Howe", "Pacific/Apia",
+    "libc:UTC", nullptr
+  };
+  for (const char* const* np = kZones; *np != nullptr; ++np) {
+    const TimeZone tz = LoadZone(*np);
+    const bool is_libc = std::string(*np).compare(0, 5, "libc:") == 0;
+    const CivilRows& r = is_libc ? libc_rows : rows;
+    const std::size_t n = r.size();
+    std::vector<int64_t> secs(n);
+    std::vector<time_point> tps(n);
+    std::vector<TimeInfo::Kind> kinds(n);
+    MakeTimes(r.Columns(), n, tz, secs.data(), kinds.data());
+    MakeTimes(r.Columns(), n, tz, tps.data(), nullptr);
+    for (std::size_t i = 0; i != n; ++i) {
+      const TimeInfo ti = MakeTimeInfo(r.year[i], r.month[i], r.day[i],
+                                       r.hour[i], r.minute[i], r.second[i],
+                                       tz);
+      time_point tp = system_clock::from_time_t(0);
+      tp += std::chrono::seconds(secs[i]);
+      EXPECT_EQ(ti.pre, tp) << *np << " @ row " << i;
+      EXPECT_EQ(ti.pre, tps[i]) << *np << " @ row " << i;
+      EXPECT_EQ(ti.kind, kinds[i]) << *np << " @ row " << i;
+    }
+  }
+
+  // The time columns may be omitted.
+  const TimeZone tz = LoadZone("America/New_York");
+  CivilColumns civil = rows.Columns();
+  civil.hour = civil.minute = civil.second = nullptr;
+  int64_t secs;
+  MakeTimes(civil, 1, tz, &secs, nullptr);
+  time_point tp = system_clock::from_time_t(0);
+  tp += std::chrono::seconds(secs);
+  EXPECT_EQ(MakeTime(rows.year[0], rows.month[0], rows.day[0], 0, 0, 0, tz),
+            tp);
+}
+
+TEST(CivilDay, FieldsAndArithmetic) {
+  const TimeZone utc = UTCTimeZone();
+  for (int64_t n = -800000; n <= 800000; n += 997) {
+    time_point tp = system_clock::from_time_t(0);
+    tp += std::chrono::hours(24 * n);
+    const Breakdown bd = BreakTime(tp, utc);
+    const CivilDay cd = CivilDay() + n;
+    EXPECT_EQ(bd.year, cd.year()) << n;
+    EXPECT_EQ(bd.month, cd.month()) << n;
+    EXPECT_EQ(bd.day, cd.day()) << n;
+    EXPECT_EQ(bd.weekday, cd.weekday()) << n;
+    EXPECT_EQ(bd.yearday, cd.yearday()) << n;
+    EXPECT_EQ(cd, CivilDay(bd.year, bd.month, bd.day));
+    EXPECT_EQ(n, cd - CivilDay());
+  }
+
+  // Normalization.
+  EXPECT_EQ(CivilDay(2016, 2, 1), CivilDay(2015, 13, 32));
+  EXPECT_EQ(CivilDay(2015, 12, 31), CivilDay(2016, 1, 0));
+  EXPECT_EQ(CivilDay(2014, 12, 1), CivilDay(2016, -12, 1));
+  EXPECT_EQ(CivilDay(2016, 3, 1), CivilDay(2016, 2, 30));
+
+  CivilDay cd(2015, 12, 31);
+  EXPECT_EQ(CivilDay(2016, 1, 1), ++cd);
+  EXPECT_EQ(CivilDay(2016, 1, 1), cd--);
+  EXPECT_EQ(CivilDay(2016, 3, 1), CivilDay(2016, 2, 28) + 2);
+  EXPECT_EQ(366, CivilDay(2017, 1, 1) - CivilDay(2016, 1, 1));
+  EXPECT_LT(CivilDay(-1, 12, 31), CivilDay(0, 1, 1));
+  EXPECT_EQ(4, CivilDay().weekday());  // Thursday
+}
+
+TEST(CivilHour, FieldsAndArithmetic) {
+  CivilHour ch(2015, 12, 31, 23);
+  EXPECT_EQ(CivilDay(2015, 12, 31), ch.civil_day());
+  EXPECT_EQ(23, ch.hour());
+  ++ch;
+  EXPECT_EQ(CivilHour(2016, 1, 1, 0), ch);
+  EXPECT_EQ(CivilHour(CivilDay(2016, 1, 1)), ch);
+  EXPECT_EQ(CivilHour(2016, 1, 1, 0), CivilHour(2015, 12, 31, 24));
+  EXPECT_EQ(48, CivilHour(2016, 1, 2, 1) - CivilHour(2015, 12, 31, 1));
+
+  ch = CivilHour(1969, 12, 31, 23);
+  EXPECT_EQ(-1, ch - CivilHour());
+  EXPECT_EQ(1969, ch.year());
+  EXPECT_EQ(12, ch.month());
+  EXPECT_EQ(31, ch.day());
+  EXPECT_EQ(23, ch.hour());
+}
+
+TEST(CivilDay, FromTimePoint) {
+  const TimeZone tz = LoadZone("America/New_York");
+  const time_point tp = MakeTime(2015, 1, 2, 3, 4, 5, tz);
+  EXPECT_EQ(CivilDay(2015, 1, 2), ToCivilDay(tp, tz));
+  EXPECT_EQ(CivilHour(2015, 1, 2, 3), ToCivilHour(tp, tz));
+  EXPECT_EQ(CivilDay(2015, 1, 2), ToCivilDay(tp, UTCTimeZone()));
+  EXPECT_EQ(CivilHour(2015, 1, 2, 8), ToCivilHour(tp, UTCTimeZone()));
+}
+
+TEST(StartOfDay, FirstInstantOfTheDay) {
+  // Includes zones whose midnight was skipped (Sao Paulo) or repeated
+  // (Havana), whose offsets change by half an hour (Lord Howe) or a whole
+  // day (Apia), or are not whole hours (Kathmandu), and the other kinds of
+  // zone.
+  const char* const kZones[] = {
+    "UTC", "America/New_York", "America/Sao_Paulo", "America/Havana",
+    "Australia/Lord_Howe", "Pacific/Apia", "Asia/Kathmandu",
+    "UTC+05:45", "libc:UTC", nullptr
+  };
+  for (const char* const* np = kZones; *np != nullptr; ++np) {
+    const TimeZone tz = LoadZone(*np);
+    for (int64_t t = -1000000000; t <= 4000000000; t += 7 * 3600 + 7) {
+      const time_point tp = system_clock::from_time_t(0) +
+                            std::chrono::seconds(t) +
+                            std::chrono::milliseconds(500);
+      const time_point day = StartOfDay(tp, tz);
+      EXPECT_LE(day, tp) << *np << " " << t;
+      EXPECT_EQ(ToCivilDay(tp, tz), ToCivilDay(day, tz)) << *np << " " << t;
+      EXPECT_NE(ToCivilDay(tp, tz),
+                ToCivilDay(day - std::chrono::seconds(1), tz))
+          << *np << " " << t;
+      EXPECT_EQ(day, system_clock::from_time_t(0) +
+                         std::chrono::seconds(StartOfDay(t, tz)));
+
+      const time_point hour = StartOfHour(tp, tz);
+      EXPECT_LE(hour, tp) << *np << " " << t;
+      EXPECT_EQ(ToCivilHour(tp, tz), ToCivilHour(hour, tz))
+          << *np << " " << t;
+      EXPECT_NE(ToCivilHour(tp, tz),
+                ToCivilHour(hour - std::chrono::seconds(1), tz))
+          << *np << " " << t;
+      EXPECT_EQ(hour, system_clock::from_time_t(0) +
+                          std::chrono::seconds(StartOfHour(t, tz)));
+    }
+  }
+
+  // 2018-11-04 began at 01:00 in Sao Paulo, when clocks moved forward.
+  const TimeZone sao = LoadZone("America/Sao_Paulo");
+  const time_point noon = MakeTime(2018, 11, 4, 12, 0, 0, sao);
+  ExpectTime(BreakTime(StartOfDay(noon, sao), sao),
+             2018, 11, 4, 1, 0, 0, -2 * 60 * 60, true, "-02");
+  ExpectTime(BreakTime(StartOfHour(noon, sao), sao),
+             2018, 11, 4, 12, 0, 0, -2 * 60 * 60, true, "-02");
+}
+
+TEST(Transitions, AmericaNewYork) {
+  const TimeZone tz = LoadZone("America/New_York");
+  const time_point jan1 = MakeTime(2013, 1, 1, 0, 0, 0, tz);
+  time_point trans;
+  ASSERT_TRUE(NextTransition(jan1, tz, &trans));
+  EXPECT_EQ(system_clock::from_time_t(1362898800), trans);  // 03-10 03:00
+  ASSERT_TRUE(PrevTransition(trans, tz, &trans));
+  EXPECT_EQ(system_clock::from_time_t(1352008800), trans);  // 11-04 01:00
+
+  // Transitions are strictly after (or before) the given time.
+  const time_point at = system_clock::from_time_t(1362898800);
+  ASSERT_TRUE(NextTransition(at, tz, &trans));
+  EXPECT_LT(at, trans);
+  ASSERT_TRUE(PrevTransition(at + std::chrono::milliseconds(1), tz, &trans));
+  EXPECT_EQ(at, trans);
+  ASSERT_TRUE(PrevTransition(at, tz, &trans));
+  EXPECT_LT(trans, at);
+
+  // The first transition is from local mean time, and the generated ones
+  // repeat every 400 years, out to the end of time.
+  int64_t first;
+  ASSERT_TRUE(NextTransition(std::numeric_limits<int64_t>::min(), tz, &first));
+  EXPECT_EQ(-2717650800, first);  // 1883-11-18 12:03:58 LMT
+  int64_t t;
+  EXPECT_FALSE(PrevTransition(first, tz, &t));
+  const int64_t kSecPer400Years = 146097LL * 24 * 60 * 60;
+  for (const int64_t base : {int64_t{1} << 33, int64_t{1} << 40}) {
+    int64_t expected, actual;
+    ASSERT_TRUE(NextTransition(base, tz, &expected));
+    ASSERT_TRUE(NextTransition(base + kSecPer400Years, tz, &actual));
+    EXPECT_EQ(expected + kSecPer400Years, actual);
+    ASSERT_TRUE(PrevTransition(base, tz, &expected));
+    ASSERT_TRUE(PrevTransition(base + kSecPer400Years, tz, &actual));
+    EXPECT_EQ(expected + kSecPer400Years, actual);
+  }
+  EXPECT_TRUE(PrevTransition(std::numeric_limits<int64_t>::max(), tz, &t));
+}
+
+TEST(Transitions, WalkMatchesBreakTime) {
+  const char* const kZones[] = {
+    "America/New_York", "Australia/Lord_Howe", "Pacific/Apia",
+    "Europe/London", "America/Sao_Paulo", "Asia/Kathmandu", nullptr
+  };
+  const int64_t kBegin = -5364662400;  // 1800-01-01 00:00:00 UTC
+  const int64_t kEnd = 16725225600;    // 2500-01-01 00:00:00 UTC
+  for (const char* const* np = kZones; *np != nullptr; ++np) {
+    const TimeZone tz = LoadZone(*np);
+    std::vector<int64_t> forward;
+    for (int64_t t = kBegin; NextTransition(t, tz, &t) && t < kEnd;) {
+      forward.push_back(t);
+    }
+    ASSERT_FALSE(forward.empty()) << *np;
+
+    // Each transition changes something, and nothing changes between
+    // them (at least wherever we look).
+    int64_t prev = kBegin;
+    for (const int64_t t : forward) {
+      const BreakdownLite before = BreakTimeLite(t - 1, {}, tz);
+      const BreakdownLite after = BreakTimeLite(t, {}, tz);
+      EXPECT_TRUE(before.offset != after.offset ||
+                  before.is_dst != after.is_dst ||
+                  std::string(before.abbr) != after.abbr)
+          << *np << " " << t;
+      const BreakdownLite start = BreakTimeLite(prev, {}, tz);
+      for (const int64_t probe : {prev + (t - prev) / 3, (prev + t) / 2}) {
+        const BreakdownLite mid = BreakTimeLite(probe, {}, tz);
+        EXPECT_EQ(start.offset, mid.offset) << *np << " " << probe;
+        EXPECT_EQ(start.is_dst, mid.is_dst) << *np << " " << probe;
+      }
+      prev = t;
+    }
+
+    // Walking backwards visits the same transitions.
+    std::vector<int64_t> backward;
+    for (int64_t t = kEnd; PrevTransition(t, tz, &t) && t > kBegin;) {
+      backward.insert(backward.begin(), t);
+    }
+    EXPECT_EQ(forward, backward) << *np;
+  }
+}
+
+TEST(Transitions, NoneForFixedOffsets) {
+  time_point trans;
+  const time_point tp = system_clock::from_time_t(0);
+  for (const char* name : {"UTC", "UTC+05:30", "Etc/GMT-3", "libc:UTC"}) {
+    const TimeZone tz = LoadZone(name);
+    EXPECT_FALSE(NextTransition(tp, tz, &trans)) << name;
+    EXPECT_FALSE(PrevTransition(tp, tz, &trans)) << name;
+  }
+  EXPECT_FALSE(NextTransition(tp, TimeZone(), &trans));
+}
+
 TEST(TimeZoneEdgeCase, AmericaNewYork) {
   const TimeZone tz = LoadZone("America/New_York");
 
@@ -756,6 +1539,39 @@ TEST(TimeZoneEdgeCase, AmericaNewYork) {
   ExpectTime(bd, 2013, 11, 3, 1, 0, 0, -5 * 3600, false, "EST");
 }
 
+TEST(TimeZoneEdgeCase, AmericaNewYorkFutureRules) {
+  const TimeZone tz = LoadZone("America/New_York");
+
+  // Years after the last zic transition use the POSIX-style rules, both
+  // within the generated range and beyond it (via the 400-year cycle).
+  for (int64_t year : {2100, 2401, 12401}) {
+    const int spring_day = (year == 2100) ? 14 : 11;
+    const int fall_day = (year == 2100) ? 7 : 4;
+
+    // Spring 1:59:59 -> 3:00:00
+    time_point tp = MakeTime(year, 3, spring_day, 1, 59, 59, tz);
+    Breakdown bd = BreakTime(tp, tz);
+    ExpectTime(bd, year, 3, spring_day, 1, 59, 59, -5 * 3600, false, "EST");
+    tp += std::chrono::seconds(1);
+    bd = BreakTime(tp, tz);
+    ExpectTime(bd, year, 3, spring_day, 3, 0, 0, -4 * 3600, true, "EDT");
+    TimeInfo ti = MakeTimeInfo(year, 3, spring_day, 2, 30, 0, tz);
+    EXPECT_EQ(TimeInfo::Kind::SKIPPED, ti.kind);
+    EXPECT_EQ(tp, ti.trans);
+
+    // Fall 1:59:59 -> 1:00:00
+    tp = MakeTime(year, 11, fall_day, 1, 59, 59, tz);
+    bd = BreakTime(tp, tz);
+    ExpectTime(bd, year, 11, fall_day, 1, 59, 59, -4 * 3600, true, "EDT");
+    tp += std::chrono::seconds(1);
+    bd = BreakTime(tp, tz);
+    ExpectTime(bd, year, 11, fall_day, 1, 0, 0, -5 * 3600, false, "EST");
+    ti = MakeTimeInfo(year, 11, fall_day, 1, 30, 0, tz);
+    EXPECT_EQ(TimeInfo::Kind::REPEATED, ti.kind);
+    EXPECT_EQ(tp, ti.trans);
+  }
+}
+
 TEST(TimeZoneEdgeCase, AmericaLosAngeles) {
   const TimeZone tz = LoadZone("America/Los_Angeles");
 
@@ -995,14 +1811,35 @@ TEST(TimeZoneEdgeCase, FixedOffsets) {
   const TimeZone gmtp5 = LoadZone("Etc/GMT+5");
   time_point tp = MakeTime(1970, 1, 1, 0, 0, 0, gmtp5);
   Breakdown bd = BreakTime(tp, gmtp5);
-  ExpectTime(bd, 1970, 1, 1, 0, 0, 0, -5 * 3600, false, "GMT+5");
+  ExpectTime(bd, 1970, 1, 1, 0, 0, 0, -5 * 3600, false, "-05");
   EXPECT_EQ(system_clock::from_time_t(5 * 3600), tp);
 
   const TimeZone gmtm5 = LoadZone("Etc/GMT-5");
   tp = MakeTime(1970, 1, 1, 0, 0, 0, gmtm5);
   bd = BreakTime(tp, gmtm5);
-  ExpectTime(bd, 1970, 1, 1, 0, 0, 0, 5 * 3600, false, "GMT-5");
+  ExpectTime(bd, 1970, 1, 1, 0, 0, 0, 5 * 3600, false, "+05");
   EXPECT_EQ(system_clock::from_time_t(-5 * 3600), tp);
+
+  // Offsets in "UTC+hh:mm" form, which need no zoneinfo.
+  const TimeZone ist = LoadZone("UTC+05:30");
+  tp = MakeTime(2013, 7, 1, 12, 0, 0, ist);
+  bd = BreakTime(tp, ist);
+  ExpectTime(bd, 2013, 7, 1, 12, 0, 0, 5 * 3600 + 30 * 60, false, "+0530");
+  EXPECT_EQ(system_clock::from_time_t(1372660200), tp);
+  const TimeZone utcm5 = LoadZone("UTC-5");
+  bd = BreakTime(system_clock::from_time_t(0), utcm5);
+  ExpectTime(bd, 1969, 12, 31, 19, 0, 0, -5 * 3600, false, "-05");
+  const TimeZone libcm5 = LoadZone("libc:UTC-05:00");
+  bd = BreakTime(system_clock::from_time_t(0), libcm5);
+  ExpectTime(bd, 1969, 12, 31, 19, 0, 0, -5 * 3600, false, "-05");
+  EXPECT_EQ(system_clock::from_time_t(0),
+            MakeTime(1969, 12, 31, 19, 0, 0, libcm5));
+
+  TimeZone tz;
+  EXPECT_FALSE(LoadTimeZone("UTC+24", &tz));
+  EXPECT_FALSE(LoadTimeZone("UTC+05:3", &tz));
+  EXPECT_FALSE(LoadTimeZone("Etc/GMT+13", &tz));
+  EXPECT_FALSE(LoadTimeZone("Etc/GMT+05", &tz));
 }
 
 TEST(TimeZoneEdgeCase, NegativeYear) {
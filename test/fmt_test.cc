@@ -16,6 +16,8 @@
 #include "src/cctz.h"
 
 #include <chrono>
+#include <cstring>
+#include <ctime>
 #include <iomanip>
 #include <sstream>
 #include <string>
@@ -184,6 +186,20 @@ TEST(Format, LocaleSpecific) {
 #endif
 }
 
+TEST(Format, NativeMatchesStrftime) {
+  // The specifiers converted without strftime(3) must still agree with it
+  // (in the C locale), including across week and year boundaries.
+  const char kFormat[] =
+      "%a %A %b %B %h %p %r %x %X %y %C %D %F %T %R %j %u %w %U %W %I";
+  const TimeZone tz = UTCTimeZone();
+  const std::time_t kStart = 915148800;  // 1999-01-01 00:00:00 UTC
+  for (std::time_t t = kStart; t < kStart + 4 * 366 * 86400; t += 7 * 3607) {
+    char buf[128];
+    ASSERT_NE(0, std::strftime(buf, sizeof(buf), kFormat, std::gmtime(&t)));
+    EXPECT_EQ(buf, Format(kFormat, system_clock::from_time_t(t), tz));
+  }
+}
+
 TEST(Format, Escaping) {
   const TimeZone tz = UTCTimeZone();
   time_point tp = system_clock::from_time_t(0);
@@ -356,6 +372,94 @@ TEST(Format, RFC1123Format) {  // locale specific
   EXPECT_EQ("28 Jun 1977 09:08:07 -0700", Format(RFC1123_no_wday, tp, tz));
 }
 
+TEST(Format, CompiledFormat) {
+  TimeZone tz;
+  EXPECT_TRUE(LoadTimeZone("America/Los_Angeles", &tz));
+  time_point tp = MakeTime(1977, 6, 28, 9, 8, 7, tz);
+  tp += milliseconds(6) + microseconds(7);
+
+  // A compiled format is reusable, and matches the uncompiled Format().
+  const char* const kFormats[] = {
+      "",          "xxx",        "%%",           "%%%",      "%Y-%m-%d %e",
+      "%H:%M:%S",  "%E3S|%E*S",  "%E4Y %s",      "%z %Ez %Z", "%a %b %D",
+      "%Ex %E",    "%E12S %E0S", "%%Y%%%Y %%%%", RFC1123_full, RFC3339_full,
+  };
+  for (const char* fmt : kFormats) {
+    const CompiledFormat compiled(fmt);
+    EXPECT_EQ(Format(fmt, tp, tz), Format(compiled, tp, tz)) << fmt;
+    EXPECT_EQ(Format(fmt, tp + hours(1000), tz),
+              Format(compiled, tp + hours(1000), tz)) << fmt;
+  }
+
+  const CompiledFormat rfc3339(RFC3339_full);
+  EXPECT_EQ("1977-06-28T09:08:07.006007-07:00", Format(rfc3339, tp, tz));
+  EXPECT_EQ("1977-06-28T16:08:07.006007+00:00",
+            Format(rfc3339, tp, UTCTimeZone()));
+}
+
+TEST(Format, CompiledFormatOutputs) {
+  const TimeZone tz = UTCTimeZone();
+  const time_point tp = system_clock::from_time_t(0) + hours(13);
+  const CompiledFormat format("%Y-%m-%d %H:%M:%S");
+  const std::string expected = "1970-01-01 13:00:00";
+
+  std::string s = "at ";
+  Format(format, tp, tz, &s);
+  EXPECT_EQ("at " + expected, s);
+
+  char buf[32];
+  EXPECT_EQ(expected.size(), Format(format, tp, tz, buf, sizeof(buf)));
+  EXPECT_EQ(expected, std::string(buf, expected.size()));
+
+  // Truncated output still reports the full length.
+  std::memset(buf, 'x', sizeof(buf));
+  EXPECT_EQ(expected.size(), Format(format, tp, tz, buf, 10));
+  EXPECT_EQ("1970-01-01xxx", std::string(buf, 13));
+  EXPECT_EQ(expected.size(), Format(format, tp, tz, nullptr, 0));
+}
+
+TEST(Format, CachedFormat) {
+  TimeZone lax, syd;
+  EXPECT_TRUE(LoadTimeZone("America/Los_Angeles", &lax));
+  EXPECT_TRUE(LoadTimeZone("Australia/Sydney", &syd));
+  const char* const kFormats[] = {
+      "",           "xxx",        "%Y-%m-%d %H:%M:%E6S %Ez", "%E*S",
+      "%E3S|%E*S",  "%E4Y %s",    "%E12S %E0S",  "%s.%E9S %E*S %Z",
+      "%%E*S %E*S", RFC3339_full, RFC3339_sec,   RFC1123_full,
+  };
+  const time_point base = MakeTime(2015, 11, 1, 1, 59, 58, lax);
+  const nanoseconds kSteps[] = {
+      nanoseconds(0),         nanoseconds(1),
+      microseconds(640),      milliseconds(500) + nanoseconds(7),
+      seconds(1) - nanoseconds(1), seconds(1), seconds(3600),
+      -nanoseconds(1),        -hours(24 * 365 * 46) - milliseconds(250),
+  };
+  for (const char* fmt : kFormats) {
+    const CachedFormat cached(fmt);
+    const CompiledFormat compiled(fmt);
+    // Revisiting the same seconds, in alternating zones, hits the cache.
+    for (int pass = 0; pass != 2; ++pass) {
+      for (const nanoseconds step : kSteps) {
+        for (const TimeZone& tz : {lax, syd}) {
+          const time_point tp = base + step;
+          EXPECT_EQ(Format(compiled, tp, tz), Format(cached, tp, tz))
+              << fmt << " " << step.count();
+        }
+      }
+    }
+  }
+
+  // The other outputs.
+  const CachedFormat format("%H:%M:%E3S");
+  const time_point tp = MakeTime(2015, 1, 2, 3, 4, 5, lax) + milliseconds(6);
+  std::string s = "at ";
+  Format(format, tp, lax, &s);
+  EXPECT_EQ("at 03:04:05.006", s);
+  char buf[8];
+  EXPECT_EQ(12u, Format(format, tp, lax, buf, sizeof(buf)));
+  EXPECT_EQ("03:04:05", std::string(buf, sizeof(buf)));
+}
+
 //
 // Testing Parse()
 //
@@ -868,6 +972,109 @@ TEST(Parse, RFC3339Format) {
   EXPECT_EQ(tp, tp2);
 }
 
+TEST(Parse, RFC3339FastPath) {
+  TimeZone lax;
+  EXPECT_TRUE(LoadTimeZone("America/Los_Angeles", &lax));
+
+  // Parse() takes a fast path for the exact RFC3339 layouts. A leading
+  // space in the format matches the same inputs, but defeats the fast
+  // path, so every result can be checked against the general parser.
+  const char* const kInputs[] = {
+      "2014-02-12T20:21:00Z",           "2014-02-12T20:21:00+00:00",
+      "2014-02-12T20:21:00.25-08:00",   "2014-02-12T20:21:00.123456789Z",
+      "2014-02-12T20:21:00.1234567891Z", "1970-01-01T00:00:00-00:00",
+      "0000-02-29T23:59:59+23:59",      "9999-12-31T23:59:59-23:59",
+      "2016-02-29T12:00:00Z",           "2015-02-29T12:00:00Z",
+      "2014-02-12T20:21:60Z",           "2014-02-12T24:00:00Z",
+      "2014-13-12T20:21:00Z",           "2014-02-12T20:21:00.Z",
+      "2014-02-12T20:21:00+0800",       "2014-02-12T20:21:00+08",
+      " 2014-02-12T20:21:00Z ",         "2014-02-12 20:21:00Z",
+      "12014-02-12T20:21:00Z",          "2014-2-12T20:21:00Z",
+      "2014-02-12T20:21:00",            "2014-02-12T20:21:00+08:00x",
+  };
+  for (const char* input : kInputs) {
+    for (const char* fmt : {RFC3339_full, RFC3339_sec}) {
+      time_point tp = system_clock::from_time_t(0);
+      time_point tp2 = tp;
+      const bool ok = Parse(fmt, input, lax, &tp);
+      EXPECT_EQ(Parse(std::string(" ") + fmt, input, lax, &tp2), ok)
+          << fmt << " " << input;
+      EXPECT_EQ(tp2, tp) << fmt << " " << input;
+    }
+  }
+
+  time_point tp;
+  EXPECT_TRUE(Parse(RFC3339_full, "2014-02-12T20:21:00.25-08:00", lax, &tp));
+  EXPECT_EQ(MakeTime(2014, 2, 12, 20, 21, 0, lax) + milliseconds(250), tp);
+}
+
+TEST(Parse, CompiledParser) {
+  TimeZone lax;
+  EXPECT_TRUE(LoadTimeZone("America/Los_Angeles", &lax));
+  const time_point expected = MakeTime(2013, 6, 28, 19, 8, 9, lax);
+
+  // Matches the whole input, which need not be NUL terminated.
+  const CompiledParser parser("%Y-%m-%d %H:%M:%S %Ez");
+  const std::string record = "2013-06-28 19:08:09 -07:00  |2013-06-28 ...";
+  time_point tp;
+  EXPECT_TRUE(Parse(parser, record.data(), 26, lax, &tp));
+  EXPECT_EQ(expected, tp);
+  EXPECT_TRUE(Parse(parser, record.data(), 28, lax, &tp));  // whitespace
+  EXPECT_FALSE(Parse(parser, record.data(), 29, lax, &tp));
+  EXPECT_FALSE(Parse(parser, record.data(), 22, lax, &tp));
+
+  // Matches a prefix of the input, reporting how much was consumed.
+  std::size_t consumed = 0;
+  tp = time_point();
+  EXPECT_TRUE(Parse(parser, record.data(), record.size(), lax, &tp,
+                    &consumed));
+  EXPECT_EQ(expected, tp);
+  EXPECT_EQ(26u, consumed);
+  EXPECT_FALSE(Parse(parser, record.data() + consumed,
+                     record.size() - consumed, lax, &tp, &consumed));
+
+  // Specifiers handed to strptime(3) see only the given input.
+  const CompiledParser rfc1123(RFC1123_full);
+  const std::string input = "Fri, 28 Jun 2013 19:08:09 -0700";
+  const std::string line = input + "Fri, 28 Jun 2013 19:08:09 -0700";
+  EXPECT_TRUE(Parse(rfc1123, line.data(), input.size(), lax, &tp));
+  EXPECT_EQ(expected, tp);
+  EXPECT_TRUE(Parse(rfc1123, line.data(), line.size(), lax, &tp,
+                    &consumed));
+  EXPECT_EQ(input.size(), consumed);
+  EXPECT_FALSE(Parse(rfc1123, line.data(), input.size() - 6, lax, &tp));
+
+  // A fixed-layout RFC3339 prefix.
+  const CompiledParser rfc3339(RFC3339_full);
+  const std::string event = "{\"ts\":\"2013-06-28T19:08:09.5-07:00\"}";
+  EXPECT_TRUE(Parse(rfc3339, event.data() + 7, event.size() - 7, lax, &tp,
+                    &consumed));
+  EXPECT_EQ(expected + milliseconds(500), tp);
+  EXPECT_EQ(27u, consumed);
+  EXPECT_FALSE(Parse(rfc3339, event.data() + 7, event.size() - 7, lax, &tp));
+}
+
+TEST(Parse, RepeatedFormats) {
+  // Parse() caches the formats it compiles, so cycle through more of them
+  // than it keeps, checking that each still parses as it should.
+  TimeZone lax;
+  EXPECT_TRUE(LoadTimeZone("America/Los_Angeles", &lax));
+  const time_point expected = MakeTime(2013, 6, 28, 19, 8, 9, lax);
+  const char* const kFormats[] = {
+      RFC3339_full, RFC3339_sec, RFC1123_full, "%Y-%m-%d %H:%M:%S",
+      "%s", "%d/%m/%Y %H:%M:%S", "%H:%M:%S %d.%m.%Y",
+  };
+  for (int pass = 0; pass != 3; ++pass) {
+    for (const char* fmt : kFormats) {
+      const std::string input = Format(fmt, expected, lax);
+      time_point tp;
+      EXPECT_TRUE(Parse(fmt, input, lax, &tp)) << fmt;
+      EXPECT_EQ(expected, tp) << fmt;
+      EXPECT_FALSE(Parse(fmt, input + "x", lax, &tp)) << fmt;
+    }
+  }
+}
+
 //
 // Roundtrip test for Format()/Parse().
 //
@@ -0,0 +1,368 @@
+// A command-line tool for rewriting the timestamps in bulk text, such as
+// log files, from one format and time zone into another. For example,
+//
+//   time_reformat --tz=America/New_York access.log > access.ny.log
+//
+// rewrites the first epoch-seconds timestamp of each line as local RFC3339.
+// Without --field a timestamp must be a whole field of the line, and as any
+// number would parse as "%s", epoch seconds must also have 9 or 10 digits
+// (i.e., be from 1973 to 2286), so that addresses, status codes and sizes
+// are left alone.
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "src/cctz.h"
+
+// Each thread converts chunks of about this many bytes at a time.
+const std::size_t kChunkSize = 4 << 20;
+
+// The widths of the plausible epoch-seconds timestamps that are taken
+// without --field.
+const std::size_t kMinEpochDigits = 9;
+const std::size_t kMaxEpochDigits = 10;
+
+const char* const kUsage =
+    " [--from=<format>] [--from_tz=<zone>] [--to=<format>] [--tz=<zone>]"
+    " [--field=<n>] [--delimiter=<c>] [--threads=<n>] [--stats] [<file>]\n";
+
+// How timestamps are found and converted.
+struct Options {
+  Options() : from("%s"), to("%Y-%m-%dT%H:%M:%E*S%Ez") {}
+
+  cctz::CompiledParser from;
+  bool epoch = true;       // whether from is just "%s"
+  cctz::TimeZone from_tz;  // for timestamps without an offset
+  cctz::CompiledFormat to;
+  cctz::TimeZone tz;
+  int field = 0;        // 1-based, or 0 to take the first match on the line
+  char delimiter = 0;   // or 0 for runs of whitespace
+};
+
+// A run of whole lines, and its conversion.
+struct Chunk {
+  const char* begin;
+  const char* end;
+  std::string out;
+  std::size_t lines = 0;
+  std::size_t converted = 0;
+};
+
+// Returns whether c separates the fields of a line.
+bool IsSeparator(const Options& opts, char c) {
+  if (opts.delimiter != 0) return c == opts.delimiter;
+  return std::isspace(static_cast<unsigned char>(c)) != 0;
+}
+
+// Sets [*fb, *fe) to the n'th field of [p, end), or *fb to nullptr if the
+// line has fewer fields.
+void FindField(const char* p, const char* end, int n, char delimiter,
+               const char** fb, const char** fe) {
+  for (int i = 1;; ++i) {
+    if (delimiter == 0) {
+      while (p != end && std::isspace(static_cast<unsigned char>(*p))) ++p;
+      if (p == end) break;
+    }
+    const char* q = p;
+    if (delimiter == 0) {
+      while (q != end && !std::isspace(static_cast<unsigned char>(*q))) ++q;
+    } else {
+      q = static_cast<const char*>(std::memchr(p, delimiter, end - p));
+      if (q == nullptr) q = end;
+    }
+    if (i == n) {
+      *fb = p;
+      *fe = q;
+      return;
+    }
+    if (q == end) break;
+    p = (delimiter == 0) ? q : q + 1;
+  }
+  *fb = nullptr;
+}
+
+// Appends the line [p, end) to *out, with its timestamp (if any) rewritten,
+// and returns whether it had one.
+bool ConvertLine(const Options& opts, const char* p, const char* end,
+                 std::string* out) {
+  cctz::time_point tp;
+  const char* tb = nullptr;  // the timestamp is [tb, te)
+  const char* te = nullptr;
+  if (opts.field != 0) {
+    FindField(p, end, opts.field, opts.delimiter, &tb, &te);
+    if (tb != nullptr &&
+        !cctz::Parse(opts.from, tb, te - tb, opts.from_tz, &tp)) {
+      tb = nullptr;
+    }
+  } else {
+    // Take the first match that is a whole field (or run of fields), and
+    // for epoch seconds, one of plausible width.
+    for (const char* q = p; q != end; ++q) {
+      if (IsSeparator(opts, *q)) continue;
+      if (q != p && !IsSeparator(opts, q[-1])) continue;
+      std::size_t n;
+      if (cctz::Parse(opts.from, q, end - q, opts.from_tz, &tp, &n) &&
+          n != 0 && (q + n == end || IsSeparator(opts, q[n])) &&
+          (!opts.epoch || (n >= kMinEpochDigits && n <= kMaxEpochDigits))) {
+        tb = q;
+        te = q + n;
+        break;
+      }
+    }
+  }
+  if (tb == nullptr) {
+    out->append(p, end);
+    return false;
+  }
+  out->append(p, tb);
+  cctz::Format(opts.to, tp, opts.tz, out);
+  out->append(te, end);
+  return true;
+}
+
+void ConvertChunk(const Options& opts, Chunk* chunk) {
+  chunk->out.reserve((chunk->end - chunk->begin) * 2);
+  for (const char* p = chunk->begin; p != chunk->end;) {
+    const char* nl = static_cast<const char*>(
+        std::memchr(p, '\n', chunk->end - p));
+    const char* eol = (nl != nullptr) ? nl : chunk->end;
+    if (ConvertLine(opts, p, eol, &chunk->out)) ++chunk->converted;
+    ++chunk->lines;
+    if (nl == nullptr) break;
+    chunk->out += '\n';
+    p = nl + 1;
+  }
+}
+
+bool WriteAll(int fd, const char* p, std::size_t n) {
+  while (n != 0) {
+    const ssize_t w = write(fd, p, n);
+    if (w < 0) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    p += w;
+    n -= static_cast<std::size_t>(w);
+  }
+  return true;
+}
+
+// Converts the whole lines [begin, end), split into chunks across up to
+// nthreads threads, and writes the results to stdout in order.
+class Converter {
+ public:
+  Converter(const Options& opts, int nthreads)
+      : opts_(opts), nthreads_(nthreads) {}
+
+  // The bytes that nthreads chunks cover, which is the most worth passing
+  // to Convert() at once.
+  std::size_t BatchSize() const { return nthreads_ * kChunkSize; }
+
+  bool Convert(const char* begin, const char* end) {
+    std::vector<Chunk> chunks;
+    for (const char* p = begin; p != end;) {
+      const char* q = end;
+      if (static_cast<std::size_t>(end - p) > kChunkSize) {
+        const void* nl = std::memchr(p + kChunkSize, '\n',
+                                     end - (p + kChunkSize));
+        if (nl != nullptr) q = static_cast<const char*>(nl) + 1;
+      }
+      chunks.emplace_back();
+      chunks.back().begin = p;
+      chunks.back().end = q;
+      p = q;
+    }
+    for (std::size_t i = 0; i < chunks.size(); i += nthreads_) {
+      const std::size_t n = std::min<std::size_t>(nthreads_,
+                                                  chunks.size() - i);
+      std::vector<std::thread> threads;
+      for (std::size_t j = 1; j < n; ++j) {
+        threads.emplace_back(ConvertChunk, std::cref(opts_), &chunks[i + j]);
+      }
+      ConvertChunk(opts_, &chunks[i]);
+      for (std::thread& thread : threads) thread.join();
+      for (std::size_t j = 0; j != n; ++j) {
+        Chunk& chunk = chunks[i + j];
+        if (!WriteAll(STDOUT_FILENO, chunk.out.data(), chunk.out.size())) {
+          write_failed_ = true;
+          return false;
+        }
+        bytes_ += chunk.end - chunk.begin;
+        lines_ += chunk.lines;
+        converted_ += chunk.converted;
+        std::string().swap(chunk.out);
+      }
+    }
+    return true;
+  }
+
+  std::size_t bytes() const { return bytes_; }
+  std::size_t lines() const { return lines_; }
+  std::size_t converted() const { return converted_; }
+  bool write_failed() const { return write_failed_; }
+
+ private:
+  const Options& opts_;
+  const int nthreads_;
+  std::size_t bytes_ = 0;
+  std::size_t lines_ = 0;
+  std::size_t converted_ = 0;
+  bool write_failed_ = false;
+};
+
+// Converts fd, mapping it if it is a regular file, and otherwise reading
+// it in batches of whole lines.
+bool ConvertFile(int fd, Converter* converter) {
+  struct stat st;
+  if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+    const std::size_t size = static_cast<std::size_t>(st.st_size);
+    void* const addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr != MAP_FAILED) {
+      madvise(addr, size, MADV_SEQUENTIAL);
+      const char* const data = static_cast<const char*>(addr);
+      const bool ok = converter->Convert(data, data + size);
+      munmap(addr, size);
+      return ok;
+    }
+  }
+  std::vector<char> buf(converter->BatchSize());
+  std::size_t len = 0;  // the bytes read, but not yet converted
+  for (bool eof = false; !eof;) {
+    if (len == buf.size()) buf.resize(buf.size() * 2);  // a very long line
+    const ssize_t r = read(fd, buf.data() + len, buf.size() - len);
+    if (r < 0) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    eof = (r == 0);
+    len += static_cast<std::size_t>(r);
+    if (!eof && len != buf.size()) continue;
+    const char* const data = buf.data();
+    const char* end = data + len;
+    if (!eof) {
+      const void* nl = memrchr(data, '\n', len);
+      if (nl == nullptr) continue;
+      end = static_cast<const char*>(nl) + 1;
+    }
+    if (!converter->Convert(data, end)) return false;
+    len = data + len - end;
+    std::memmove(buf.data(), end, len);
+  }
+  return true;
+}
+
+int main(int argc, char** argv) {
+  const char* prog = argv[0] ? argv[0] : "time_reformat";
+  if (const char* b = std::strrchr(prog, '/')) prog = b + 1;
+
+  Options opts;
+  opts.from_tz = cctz::UTCTimeZone();
+  opts.tz = cctz::LocalTimeZone();
+  int nthreads = std::max(1u, std::thread::hardware_concurrency());
+  bool stats = false;
+  for (;;) {
+    static option long_opts[] = {
+        {"from", required_argument, nullptr, 'f'},
+        {"from_tz", required_argument, nullptr, 'Z'},
+        {"to", required_argument, nullptr, 't'},
+        {"tz", required_argument, nullptr, 'z'},
+        {"field", required_argument, nullptr, 'k'},
+        {"delimiter", required_argument, nullptr, 'd'},
+        {"threads", required_argument, nullptr, 'j'},
+        {"stats", no_argument, nullptr, 's'},
+        {nullptr, 0, nullptr, 0},
+    };
+    int c = getopt_long(argc, argv, "f:Z:t:z:k:d:j:s", long_opts, nullptr);
+    if (c == -1) break;
+    switch (c) {
+      case 'f':
+        opts.from = cctz::CompiledParser(optarg);
+        opts.epoch = (std::strcmp(optarg, "%s") == 0);
+        break;
+      case 'Z':
+      case 'z':
+        if (!cctz::LoadTimeZone(optarg,
+                                (c == 'z') ? &opts.tz : &opts.from_tz)) {
+          std::cerr << optarg << ": Unrecognized time zone\n";
+          return 1;
+        }
+        break;
+      case 't':
+        opts.to = cctz::CompiledFormat(optarg);
+        break;
+      case 'k':
+        opts.field = std::atoi(optarg);
+        if (opts.field < 1) {
+          std::cerr << optarg << ": Invalid field number\n";
+          return 1;
+        }
+        break;
+      case 'd':
+        if (std::strlen(optarg) != 1) {
+          std::cerr << optarg << ": Delimiter must be a single character\n";
+          return 1;
+        }
+        opts.delimiter = optarg[0];
+        break;
+      case 'j':
+        nthreads = std::max(1, std::atoi(optarg));
+        break;
+      case 's':
+        stats = true;
+        break;
+      default:
+        std::cerr << "Usage: " << prog << kUsage;
+        return 1;
+    }
+  }
+  if (argc - optind > 1) {
+    std::cerr << "Usage: " << prog << kUsage;
+    return 1;
+  }
+
+  int fd = STDIN_FILENO;
+  const char* const path = (optind != argc) ? argv[optind] : "-";
+  if (std::strcmp(path, "-") != 0) {
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+      std::cerr << path << ": " << std::strerror(errno) << "\n";
+      return 1;
+    }
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  Converter converter(opts, nthreads);
+  if (!ConvertFile(fd, &converter)) {
+    const char* const what = converter.write_failed() ? "stdout" : path;
+    std::cerr << what << ": " << std::strerror(errno) << "\n";
+    return 1;
+  }
+  if (fd != STDIN_FILENO) close(fd);
+
+  if (stats) {
+    const std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    const double secs = std::max(elapsed.count(), 1e-9);
+    const double mb = converter.bytes() / 1e6;
+    std::fprintf(stderr,
+                 "%s: %zu lines (%zu converted), %.1f MB in %.3f s"
+                 " (%.1f MB/s, %.0f lines/s, %d threads)\n",
+                 prog, converter.lines(), converter.converted(), mb, secs,
+                 mb / secs, converter.lines() / secs, nthreads);
+  }
+  return 0;
+}
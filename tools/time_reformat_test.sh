@@ -0,0 +1,44 @@
+#!/bin/bash
+# Checks which parts of a line time_reformat takes as its timestamp.
+
+TOOL="${TEST_SRCDIR:-.}/${TEST_WORKSPACE:+$TEST_WORKSPACE/}tools/time_reformat"
+[ -x "$TOOL" ] || TOOL="${1:?usage: $0 <time_reformat>}"
+
+failures=0
+expect() {
+  local input="$1" expected="$2"
+  shift 2
+  local actual
+  actual=$(printf '%s\n' "$input" | "$TOOL" --tz=UTC --threads=1 "$@")
+  if [ "$actual" != "$expected" ]; then
+    echo "time_reformat $*: '$input'"
+    echo "  got:  '$actual'"
+    echo "  want: '$expected'"
+    failures=$((failures + 1))
+  fi
+}
+
+# Neither an IP-address octet nor a status code is epoch seconds.
+expect '127.0.0.1 - - 1400000000 "GET / HTTP/1.1" 200' \
+       '127.0.0.1 - - 2014-05-13T16:53:20+00:00 "GET / HTTP/1.1" 200'
+expect 'x 200 y 1400000001' 'x 200 y 2014-05-13T16:53:21+00:00'
+
+# Nor is a timestamp that is only part of a field.
+expect 'id=1400000000 1400000002' 'id=1400000000 2014-05-13T16:53:22+00:00'
+expect 'none 12345 here' 'none 12345 here'
+
+# Fields are split at the delimiter when one is given.
+expect 'a,1400000000,b' 'a,2014-05-13T16:53:20+00:00,b' --delimiter=,
+
+# An explicit field is taken whatever its width.
+expect 'x 200 y' 'x 1970-01-01T00:03:20+00:00 y' --field=2
+
+# Other formats need only match whole fields, and are replaced entirely.
+expect '10.0.0.1 [2014-05-13 16:53:20] ok' \
+       '10.0.0.1 2014-05-13T16:53:20+00:00 ok' --from='[%Y-%m-%d %H:%M:%S]'
+
+if [ "$failures" -ne 0 ]; then
+  echo "$failures failures"
+  exit 1
+fi
+echo PASS
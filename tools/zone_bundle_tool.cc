@@ -0,0 +1,110 @@
+// A command-line tool for building CCTZ zone bundles (see cctz_bundle.h),
+// either as bundle files to be mapped at run time, or as C++ sources that
+// compile a bundle into the binary (see //src:embedded_zones.bzl).
+
+#include <getopt.h>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "src/cctz.h"
+#include "src/cctz_bundle.h"
+
+// Returns a C++ source file that registers the bundle as built in.
+std::string BundleSource(const std::string& bundle) {
+  std::string src =
+      "// Generated by zone_bundle_tool. DO NOT EDIT.\n"
+      "\n"
+      "#include \"src/cctz_bundle.h\"\n"
+      "\n"
+      "namespace {\n"
+      "\n"
+      "// The bundle is used in place, so it must be suitably aligned.\n"
+      "alignas(8) const char kZoneBundle[] =\n";
+  for (std::size_t i = 0; i < bundle.size(); i += 16) {
+    src += "    \"";
+    for (std::size_t j = i; j != bundle.size() && j != i + 16; ++j) {
+      const unsigned char c = bundle[j];
+      char octal[5];
+      std::snprintf(octal, sizeof octal, "\\%03o", c);
+      src += octal;  // fixed width, so it never absorbs the next char
+    }
+    src += "\"\n";
+  }
+  src +=
+      "    \"\";\n"
+      "\n"
+      "struct RegisterZoneBundle {\n"
+      "  RegisterZoneBundle() {\n"
+      "    cctz::RegisterBuiltinZoneBundle(kZoneBundle,\n"
+      "                                    sizeof kZoneBundle - 1);\n"
+      "  }\n"
+      "} register_zone_bundle;\n"
+      "\n"
+      "}  // namespace\n";
+  return src;
+}
+
+int main(int argc, char** argv) {
+  const char* tzdir = std::getenv("TZDIR");
+  std::string zoneinfo = tzdir ? tzdir : "/usr/share/zoneinfo";
+  bool cc = false;
+  for (;;) {
+    static option opts[] = {
+        {"zoneinfo", required_argument, nullptr, 'd'},
+        {"cc", no_argument, nullptr, 'c'},
+        {nullptr, 0, nullptr, 0},
+    };
+    int c = getopt_long(argc, argv, "d:c", opts, nullptr);
+    if (c == -1) break;
+    switch (c) {
+      case 'd':
+        zoneinfo = optarg;
+        break;
+      case 'c':
+        cc = true;
+        break;
+      default:
+        std::cerr << "Usage: " << argv[0]
+                  << " [--zoneinfo=<dir>] [--cc] <output> [<zone> ...]\n";
+        return 1;
+    }
+  }
+  if (optind == argc) {
+    std::cerr << "Usage: " << argv[0]
+              << " [--zoneinfo=<dir>] [--cc] <output> [<zone> ...]\n";
+    return 1;
+  }
+  const std::string output = argv[optind++];
+  setenv("TZDIR", zoneinfo.c_str(), 1);  // where the zones are loaded from
+
+  // Bundle the named zones, or else every zone in the zoneinfo tree.
+  std::vector<std::string> names(argv + optind, argv + argc);
+  if (names.empty()) names = cctz::ZoneinfoNames();
+
+  std::string bundle;
+  std::vector<std::string> skipped;
+  cctz::BuildZoneBundle(names, &bundle, &skipped);
+  for (const std::string& name : skipped) {
+    std::cerr << name << ": Skipped\n";
+  }
+  const std::string contents = cc ? BundleSource(bundle) : bundle;
+
+  // Write to a file alongside the output and then move it into place, so
+  // that no process ever maps a partial bundle.
+  const std::string temp = output + ".tmp";
+  std::ofstream ofs(temp, std::ios::binary | std::ios::trunc);
+  ofs.write(contents.data(), contents.size());
+  ofs.close();
+  if (!ofs || std::rename(temp.c_str(), output.c_str()) != 0) {
+    std::cerr << output << ": Write failed\n";
+    std::remove(temp.c_str());
+    return 1;
+  }
+  std::cout << output << ": " << (names.size() - skipped.size())
+            << " zones, " << bundle.size() << " bytes\n";
+  return 0;
+}